@@ -0,0 +1,220 @@
+#include "gfx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+constexpr gfx::vector canvas_size{1024, 768};
+constexpr auto min_time = std::chrono::milliseconds{200};
+constexpr auto min_runs = 5;
+
+struct result
+{
+    std::string primitive;
+    int32_t size{};
+    int32_t count{};
+    double ns_per_op{};
+};
+
+// Spreads count positions over the canvas, keeping a size * size shape inside it
+std::vector<gfx::point> positions(int32_t count, int32_t size)
+{
+    std::vector<gfx::point> ps(static_cast<std::size_t>(count));
+    auto const w = std::max(1, canvas_size.x - size);
+    auto const h = std::max(1, canvas_size.y - size);
+    for (int32_t i = 0; i < count; ++i) {
+        ps[static_cast<std::size_t>(i)] = {(i * 193) % w, (i * 71) % h};
+    }
+    return ps;
+}
+
+// Runs one batch of count operations until enough time has passed, and keeps the fastest run. The canvas pixels are
+// read after each batch so that the software renderer has finished drawing it.
+double measure(gfx::canvas& can, int32_t count, std::function<void()> const& batch)
+{
+    auto best = clock::duration::max();
+    auto const until = clock::now() + min_time;
+    for (auto run = 0; run < min_runs || clock::now() < until; ++run) {
+        auto const t0 = clock::now();
+        batch();
+        (void)can.pixels();
+        best = std::min(best, clock::now() - t0);
+    }
+    return std::chrono::duration<double, std::nano>(best).count() / count;
+}
+
+void bench_shapes(gfx::canvas& can, std::vector<result>& results, int32_t size, int32_t count)
+{
+    auto const ps = positions(count, size);
+    auto const col = gfx::color{200, 100, 50};
+    auto const add = [&](char const* name, std::function<void()> const& batch) {
+        results.push_back({name, size, count, measure(can, count, batch)});
+    };
+
+    add("point", [&] {
+        for (auto const& p : ps) {
+            gfx::draw_point(can, p, col);
+        }
+    });
+    add("line", [&] {
+        for (auto const& p : ps) {
+            gfx::draw_line(can, p, {p.x + size - 1, p.y + size / 2}, col);
+        }
+    });
+    add("rect_fill", [&] {
+        for (auto const& p : ps) {
+            gfx::draw_rect(can, p, {size, size}, col, gfx::fill::on);
+        }
+    });
+    add("rect_outline", [&] {
+        for (auto const& p : ps) {
+            gfx::draw_rect(can, p, {size, size}, col, gfx::fill::off);
+        }
+    });
+    add("circle_fill", [&] {
+        for (auto const& p : ps) {
+            gfx::draw_circle(can, {p.x + size / 2, p.y + size / 2}, size / 2, col, gfx::fill::on);
+        }
+    });
+    add("circle_outline", [&] {
+        for (auto const& p : ps) {
+            gfx::draw_circle(can, {p.x + size / 2, p.y + size / 2}, size / 2, col, gfx::fill::off);
+        }
+    });
+
+    if (auto st = gfx::streaming_texture::create(can, {size, size})) {
+        auto const pixels = st->lock();
+        std::fill(pixels.begin(), pixels.end(), col);
+        auto const& tex = st->tex();
+        add("texture_blit", [&] {
+            for (auto const& p : ps) {
+                gfx::draw_texture(can, tex, p);
+            }
+        });
+    }
+}
+
+void bench_text(gfx::canvas& can, std::vector<result>& results, std::string const& font_path, int32_t size, int32_t count)
+{
+    auto f = gfx::font::load(font_path, size);
+    if (!f) {
+        return;
+    }
+    auto const ps = positions(count, size * 8);
+    auto const text = std::string{"Benchmark"};
+    auto const batch = [&] {
+        for (auto const& p : ps) {
+            gfx::draw_text(can, text, *f, p, gfx::white);
+        }
+    };
+    // The first batch fills the glyph atlas, which is not what is measured
+    batch();
+    results.push_back({"text", size, count, measure(can, count, batch)});
+}
+
+void bench_color_blend(gfx::canvas& can, std::vector<result>& results, int32_t count)
+{
+    auto const n = static_cast<std::size_t>(count);
+    std::vector<gfx::color> c0(n, gfx::color{10, 20, 30});
+    std::vector<gfx::color> c1(n, gfx::color{200, 100, 50});
+    std::vector<gfx::color> out(n);
+    std::vector<float> fractions(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        fractions[i] = static_cast<float>(i % 256) / 255.f;
+    }
+    results.push_back({"color_blend", 1, count, measure(can, count, [&] { gfx::color_blend(c0, c1, fractions, out); })});
+}
+
+void bench_pixels(gfx::canvas& can, std::vector<result>& results, int32_t size)
+{
+    auto const n = static_cast<std::size_t>(size) * static_cast<std::size_t>(size);
+    std::vector<gfx::color> src(n);
+    std::vector<gfx::color> dst(n, gfx::color{10, 20, 30});
+    for (std::size_t i = 0; i < n; ++i) {
+        src[i] = gfx::color{static_cast<uint8_t>(i), 100, 50, static_cast<uint8_t>(i * 7)};
+    }
+    auto const s = gfx::const_pixel_view{std::span<gfx::color const>{src}, {size, size}};
+    auto const d = gfx::pixel_view{dst, {size, size}};
+    auto const count = static_cast<int32_t>(n);
+    results.push_back({"pixels_fill", size, count, measure(can, count, [&] { gfx::pixels_fill(d, gfx::red); })});
+    results.push_back({"pixels_copy", size, count, measure(can, count, [&] { gfx::pixels_copy(d, s); })});
+    results.push_back({"pixels_blend", size, count, measure(can, count, [&] { gfx::pixels_blend(d, s); })});
+    results.push_back({"pixels_keyed", size, count, measure(can, count, [&] { gfx::pixels_blit_keyed(d, s, gfx::black); })});
+}
+
+void print_table(std::vector<result> const& results)
+{
+    std::printf("%-16s %6s %8s %12s %14s\n", "primitive", "size", "count", "ns/op", "Mprims/s");
+    for (auto const& r : results) {
+        std::printf("%-16s %6d %8d %12.1f %14.3f\n", r.primitive.c_str(), r.size, r.count, r.ns_per_op, 1e3 / r.ns_per_op);
+    }
+}
+
+bool write_json(std::vector<result> const& results, char const* path)
+{
+    auto* out = std::fopen(path, "w");
+    if (out == nullptr) {
+        return false;
+    }
+    std::fprintf(out, "{\n  \"canvas\": [%d, %d],\n  \"results\": [\n", canvas_size.x, canvas_size.y);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        auto const& r = results[i];
+        std::fprintf(out, "    {\"primitive\": \"%s\", \"size\": %d, \"count\": %d, \"ns_per_op\": %.3f, \"prims_per_s\": %.1f}%s\n", r.primitive.c_str(), r.size, r.count, r.ns_per_op, 1e9 / r.ns_per_op, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+    return std::fclose(out) == 0;
+}
+
+}
+
+// Usage: bench [--json <file>] [--font <file>]
+int main(int argc, char* argv[])
+{
+    char const* json{};
+    std::string font_path{"test.ttf"};
+    for (auto i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            json = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--font") == 0) {
+            font_path = argv[i + 1];
+        }
+    }
+
+    // A canvas without a window draws with the software renderer and needs no video driver
+    gfx::canvas can{canvas_size};
+
+    std::vector<result> results;
+    for (auto size : {4, 32, 256}) {
+        for (auto count : {10, 1000}) {
+            bench_shapes(can, results, size, count);
+        }
+    }
+    for (auto size : {12, 32}) {
+        for (auto count : {100, 1000}) {
+            bench_text(can, results, font_path, size, count);
+        }
+    }
+    for (auto count : {64, 4096, 262144}) {
+        bench_color_blend(can, results, count);
+    }
+    for (auto size : {16, 256}) {
+        bench_pixels(can, results, size);
+    }
+
+    print_table(results);
+    if (json != nullptr && !write_json(results, json)) {
+        std::fprintf(stderr, "could not write %s\n", json);
+        return 1;
+    }
+}
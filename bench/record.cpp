@@ -0,0 +1,102 @@
+#include "gfx.h"
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr auto shapes_per_frame = 200000;
+constexpr auto frames = 50;
+
+// Records this worker's share of a frame: a mix of single shapes and small batches
+void record(gfx::command_buffer& cb, int32_t first, int32_t last)
+{
+    gfx::point ps[4]{};
+    for (auto i = first; i < last; ++i) {
+        auto const x = (i * 37) % 1024;
+        auto const y = (i * 91) % 768;
+        auto const col = gfx::color{static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 128, 255};
+        switch (i % 4) {
+        case 0:
+            gfx::draw_rect(cb, {x, y}, {8, 8}, col, gfx::fill::on);
+            break;
+        case 1:
+            gfx::draw_line(cb, {x, y}, {x + 16, y + 4}, col);
+            break;
+        case 2:
+            gfx::draw_circle(cb, {x, y}, 6, col);
+            break;
+        default:
+            for (auto j = 0; j < 4; ++j) {
+                ps[j] = {x + j, y + j};
+            }
+            gfx::draw_points(cb, ps, col);
+            break;
+        }
+    }
+}
+
+struct result
+{
+    double record_ms{};
+    double submit_ms{};
+};
+
+result run(gfx::canvas& can, unsigned threads)
+{
+    using clock = std::chrono::steady_clock;
+
+    gfx::command_queue q{threads};
+    std::barrier start{static_cast<std::ptrdiff_t>(threads + 1)};
+    std::barrier done{static_cast<std::ptrdiff_t>(threads + 1)};
+
+    std::vector<std::jthread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            auto const share = shapes_per_frame / static_cast<int32_t>(threads);
+            auto const first = static_cast<int32_t>(t) * share;
+            auto const last = (t + 1 == threads) ? shapes_per_frame : first + share;
+            for (auto f = 0; f < frames; ++f) {
+                start.arrive_and_wait();
+                record(q[t], first, last);
+                done.arrive_and_wait();
+            }
+        });
+    }
+
+    result r;
+    for (auto f = 0; f < frames; ++f) {
+        auto const t0 = clock::now();
+        start.arrive_and_wait();
+        done.arrive_and_wait();
+        auto const t1 = clock::now();
+        gfx::submit(can, q);
+        auto const t2 = clock::now();
+        r.record_ms += std::chrono::duration<double, std::milli>(t1 - t0).count() / frames;
+        r.submit_ms += std::chrono::duration<double, std::milli>(t2 - t1).count() / frames;
+    }
+    return r;
+}
+
+}
+
+int main()
+{
+    gfx::canvas can{gfx::vector{1024, 768}};
+
+    auto const max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("%8s %12s %16s %12s\n", "threads", "record ms", "Mshapes/s", "submit ms");
+    double base{};
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        auto const r = run(can, threads);
+        if (threads == 1) {
+            base = r.record_ms;
+        }
+        std::printf("%8u %12.3f %16.2f %12.3f  (x%.2f)\n", threads, r.record_ms, shapes_per_frame / r.record_ms / 1000.0, r.submit_ms, base / r.record_ms);
+    }
+}
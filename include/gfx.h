@@ -13,12 +13,20 @@ It is also recommended that you include a file called COPYING (or COPYING.txt) c
 */
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <filesystem>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <span>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace gfx {
 
@@ -135,6 +143,14 @@ operator-=(point& p, vector v) noexcept
     return p;
 }
 
+struct rect
+{
+    point pos{};
+    vector size{};
+
+    [[nodiscard]] friend constexpr bool operator==(rect const& r0, rect const& r1) = default;
+};
+
 struct color
 {
     uint8_t r{};
@@ -174,6 +190,68 @@ inline constexpr color aqua{0, 255, 255};
 
 color color_blend(color c0, color c1, float fraction) noexcept;
 
+void color_blend(std::span<color const> c0, std::span<color const> c1, std::span<float const> fractions, std::span<color> out) noexcept;
+
+// A rectangle of pixels in a larger buffer, with rows stride pixels apart
+template<typename T>
+struct basic_pixel_view
+{
+    std::span<T> pixels{};
+    vector size{};
+    std::size_t stride{};
+
+    constexpr basic_pixel_view() noexcept = default;
+
+    constexpr basic_pixel_view(std::span<T> ps, vector sz, std::size_t st) noexcept
+        : pixels{ps}
+        , size{sz}
+        , stride{st}
+    {}
+
+    constexpr basic_pixel_view(std::span<T> ps, vector sz) noexcept
+        : basic_pixel_view{ps, sz, static_cast<std::size_t>(sz.x)}
+    {}
+
+    template<typename U>
+        requires std::is_convertible_v<U (*)[], T (*)[]>
+    constexpr basic_pixel_view(basic_pixel_view<U> const& v) noexcept
+        : basic_pixel_view{v.pixels, v.size, v.stride}
+    {}
+
+    [[nodiscard]] constexpr std::span<T> row(int32_t y) const noexcept
+    {
+        return pixels.subspan(static_cast<std::size_t>(y) * stride, static_cast<std::size_t>(size.x));
+    }
+
+    [[nodiscard]] constexpr T& operator[](point const& p) const noexcept
+    {
+        return pixels[static_cast<std::size_t>(p.y) * stride + static_cast<std::size_t>(p.x)];
+    }
+
+    [[nodiscard]] constexpr bool empty() const noexcept
+    {
+        return size.x <= 0 || size.y <= 0;
+    }
+};
+
+using pixel_view = basic_pixel_view<color>;
+
+using const_pixel_view = basic_pixel_view<color const>;
+
+void pixels_fill(pixel_view const& dst, color const& col) noexcept;
+
+void pixels_copy(pixel_view const& dst, const_pixel_view const& src) noexcept;
+
+void pixels_blend(pixel_view const& dst, const_pixel_view const& src) noexcept;
+
+void pixels_blit_keyed(pixel_view const& dst, const_pixel_view const& src, color const& key) noexcept;
+
+struct gradient_stop
+{
+    float offset{};
+    color col{};
+};
+
 enum class visibility
 {
     on,
@@ -206,8 +284,42 @@ public:
     friend class canvas;
 };
 
+class mapped_file
+{
+    std::span<std::byte const> bytes_{};
+
+    explicit constexpr mapped_file(std::span<std::byte const> bytes) noexcept : bytes_{bytes} {}
+
+public:
+    ~mapped_file();
+
+    mapped_file() = default;
+
+    mapped_file(mapped_file const&) = delete;
+
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    constexpr mapped_file(mapped_file&& rhs) noexcept
+        : bytes_{std::exchange(rhs.bytes_, {})}
+    {}
+
+    mapped_file& operator=(mapped_file&& rhs) noexcept;
+
+    [[nodiscard]] static std::optional<mapped_file> open(std::filesystem::path const& path) noexcept;
+
+    [[nodiscard]] std::span<std::byte const> bytes() const noexcept;
+};
+
 class canvas;
 
+class canvas_lock;
+
+class text;
+
+class async_texture;
+
+class streaming_texture;
+
 class texture
 {
     void* handle{};
@@ -233,6 +345,16 @@ public:
 
     [[nodiscard]] static std::optional<texture> load(canvas& can, std::filesystem::path const& path) noexcept;
 
+    [[nodiscard]] static std::optional<texture> load(canvas& can, std::span<std::byte const> bytes) noexcept;
+
+    [[nodiscard]] static std::optional<texture> create_target(canvas& can, vector size) noexcept;
+
+    [[nodiscard]] static std::optional<texture> load_cached(canvas& can, std::filesystem::path const& path) noexcept;
+
+    [[nodiscard]] static async_texture load_async(canvas& can, std::filesystem::path const& path) noexcept;
+
+    [[nodiscard]] static std::vector<async_texture> load_all(canvas& can, std::span<std::filesystem::path const> paths) noexcept;
+
     friend void draw_texture(canvas& can, texture const& tex) noexcept;
 
     friend void draw_texture(canvas& can, texture const& tex, point const& p) noexcept;
@@ -240,8 +362,105 @@ public:
     friend void draw_texture(canvas& can, texture const& tex, point const& p, vector const& s) noexcept;
 
     friend void draw_texture(canvas& can, texture const& tex, point const& p, vector const& s, point const& tp, vector const& ts) noexcept;
+
+    friend class text;
+
+    friend class streaming_texture;
+
+    friend class target_guard;
+
+    friend void draw_text(canvas& can, text const& t, point const& p) noexcept;
+};
+
+enum class load_status
+{
+    pending,
+    ready,
+    failed
+};
+
+class async_texture
+{
+    struct state
+    {
+        gfx::texture tex{};
+        std::atomic<load_status> status{load_status::pending};
+    };
+
+    std::shared_ptr<state> state_{};
+
+public:
+    [[nodiscard]] load_status status() const noexcept;
+
+    [[nodiscard]] gfx::texture const& get() const noexcept;
+
+    [[nodiscard]] gfx::texture const& get(gfx::texture const& placeholder) const noexcept;
+
+    friend class texture;
+};
+
+struct sprite
+{
+    uint32_t page{};
+    rect area{};
+
+    [[nodiscard]] friend constexpr bool operator==(sprite const& s0, sprite const& s1) = default;
+};
+
+class atlas
+{
+    void* handle{};
+
+public:
+    ~atlas();
+
+    explicit atlas(canvas& can, vector page_size = {1024, 1024}) noexcept;
+
+    atlas(atlas const&) = delete;
+
+    atlas& operator=(atlas const&) = delete;
+
+    constexpr atlas(atlas&& rhs) noexcept
+        : handle{std::exchange(rhs.handle, nullptr)}
+    {}
+
+    atlas& operator=(atlas&& rhs) noexcept;
+
+    [[nodiscard]] std::optional<sprite> add(std::filesystem::path const& path) noexcept;
+
+    [[nodiscard]] std::optional<sprite> add(std::span<std::byte const> bytes) noexcept;
+
+    [[nodiscard]] std::optional<sprite> add(std::span<color const> pixels, vector size) noexcept;
+
+    [[nodiscard]] std::size_t pages() const noexcept;
+
+    friend void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p) noexcept;
+
+    friend void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p, vector const& size) noexcept;
+
+    friend void draw_sprites(canvas& can, atlas const& a, std::span<sprite const> ss, std::span<point const> ps) noexcept;
 };
 
+struct glyph_atlas_stats
+{
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t evictions{};
+
+    [[nodiscard]] friend constexpr bool operator==(glyph_atlas_stats const& s0, glyph_atlas_stats const& s1) = default;
+};
+
+struct font_library_stats
+{
+    std::size_t faces{};
+    std::size_t sizes{};
+    std::size_t bytes{};
+
+    [[nodiscard]] friend constexpr bool operator==(font_library_stats const& s0, font_library_stats const& s1) = default;
+};
+
+class font_library;
+
 class font
 {
     void* handle{};
@@ -265,13 +484,128 @@ public:
 
     [[nodiscard]] static std::optional<font> load(std::filesystem::path const&, int32_t) noexcept;
 
+    [[nodiscard]] static std::optional<font> load(std::span<std::byte const>, int32_t) noexcept;
+
     [[nodiscard]] static vector text_size(font& f, char const* text) noexcept;
 
     [[nodiscard]] static vector text_size(font& f, std::string const& text) noexcept;
 
+    [[nodiscard]] static vector text_size(font const& f, std::string_view text) noexcept;
+
+    static void text_size(font const& f, std::span<std::string_view const> texts, std::span<vector> out) noexcept;
+
+    [[nodiscard]] glyph_atlas_stats atlas_stats() const noexcept;
+
     friend void draw_text(canvas& can, std::string const& text, font const& f, point const& p) noexcept;
 
     friend void draw_text(canvas& can, std::string const& text, font const& f, point const& p, color const& col) noexcept;
+
+    friend class text;
+
+    friend class font_library;
+};
+
+class font_library
+{
+    void* handle{};
+
+public:
+    ~font_library();
+
+    font_library() noexcept;
+
+    font_library(font_library const&) = delete;
+
+    font_library& operator=(font_library const&) = delete;
+
+    constexpr font_library(font_library&& rhs) noexcept
+        : handle{std::exchange(rhs.handle, nullptr)}
+    {}
+
+    font_library& operator=(font_library&& rhs) noexcept;
+
+    [[nodiscard]] std::optional<font> load(std::filesystem::path const& path, int32_t size) noexcept;
+
+    [[nodiscard]] font_library_stats stats() const noexcept;
+};
+
+class text
+{
+    gfx::texture tex_{};
+    void* canvas_handle{};
+    gfx::font font_{};
+    std::string str_{};
+    color col_{};
+    vector size_{};
+
+    text(void* ch, void* fh, std::string const& str, color const& col) noexcept;
+
+    void rebuild() noexcept;
+
+public:
+    text() = default;
+
+    text(text const&) = delete;
+
+    text& operator=(text const&) = delete;
+
+    text(text&& rhs) noexcept = default;
+
+    text& operator=(text&& rhs) noexcept = default;
+
+    [[nodiscard]] static std::optional<text> create(canvas& can, font const& f, std::string const& str, color const& col) noexcept;
+
+    [[nodiscard]] vector size() const noexcept;
+
+    [[nodiscard]] std::string const& str() const noexcept;
+
+    [[nodiscard]] color col() const noexcept;
+
+    [[nodiscard]] gfx::texture const& tex() const noexcept;
+
+    void set(std::string const& str) noexcept;
+
+    void set(color const& col) noexcept;
+
+    friend void draw_text(canvas& can, text const& t, point const& p) noexcept;
+};
+
+class streaming_texture
+{
+    void* canvas_handle_{};
+    gfx::texture tex_{};
+    std::vector<color> pixels_{};
+    std::vector<rect> dirty_{};
+    vector size_{};
+
+    streaming_texture(void* ch, void* th, vector size) noexcept;
+
+    void invalidate_clipped(rect r) noexcept;
+
+public:
+    streaming_texture() = default;
+
+    streaming_texture(streaming_texture const&) = delete;
+
+    streaming_texture& operator=(streaming_texture const&) = delete;
+
+    streaming_texture(streaming_texture&& rhs) noexcept = default;
+
+    streaming_texture& operator=(streaming_texture&& rhs) noexcept = default;
+
+    [[nodiscard]] static std::optional<streaming_texture> create(canvas& can, vector size) noexcept;
+
+    [[nodiscard]] vector size() const noexcept;
+
+    [[nodiscard]] std::span<color> lock() noexcept;
+
+    [[nodiscard]] std::span<color> lock(rect const& r) noexcept;
+
+    void update(rect const& r, std::span<color const> pixels) noexcept;
+
+    [[nodiscard]] std::span<rect const> dirty() const noexcept;
+
+    [[nodiscard]] gfx::texture const& tex() noexcept;
 };
 
 enum class vsync
@@ -286,6 +620,76 @@ enum class fill
     off
 };
 
+enum class blend
+{
+    none,
+    alpha,
+    add,
+    mod
+};
+
+enum class dedupe
+{
+    path,
+    content
+};
+
+enum class redraw
+{
+    full,
+    partial
+};
+
+struct texture_cache_stats
+{
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t evictions{};
+    std::size_t bytes{};
+    std::size_t entries{};
+
+    [[nodiscard]] friend constexpr bool operator==(texture_cache_stats const& s0, texture_cache_stats const& s1) = default;
+};
+
+struct draw_state_stats
+{
+    uint64_t changes{};
+    uint64_t elided{};
+
+    [[nodiscard]] friend constexpr bool operator==(draw_state_stats const& s0, draw_state_stats const& s1) = default;
+};
+
+struct draw_call_stats
+{
+    uint64_t points{};
+    uint64_t lines{};
+    uint64_t rects{};
+    uint64_t images{};
+    uint64_t textures{};
+    uint64_t sprites{};
+    uint64_t texts{};
+
+    [[nodiscard]] friend constexpr bool operator==(draw_call_stats const& s0, draw_call_stats const& s1) = default;
+};
+
+struct frame_stats
+{
+    draw_call_stats draw_calls{};
+    draw_state_stats state{};
+    uint64_t sdl_calls{};
+    uint64_t uploads{};
+    std::size_t upload_bytes{};
+    uint64_t rasterizations{};
+    double render_ms{};
+    double present_ms{};
+    double frame_ms{};
+    double frame_ms_p50{};
+    double frame_ms_p90{};
+    double frame_ms_p99{};
+
+    [[nodiscard]] friend constexpr bool operator==(frame_stats const& s0, frame_stats const& s1) = default;
+};
+
 class canvas
 {
     void* handle{};
@@ -296,6 +700,8 @@ public:
 
     explicit canvas(window const& window, vsync vs = vsync::on) noexcept;
 
+    explicit canvas(vector size) noexcept;
+
     canvas(canvas const&) = delete;
 
     canvas& operator=(canvas const&) = delete;
@@ -308,14 +714,36 @@ public:
 
     [[nodiscard]] color operator[](point const& p) const noexcept;
 
+    [[nodiscard]] bool read(rect const& r, std::span<color> out) const noexcept;
+
     [[nodiscard]] vector size() const noexcept;
 
     [[nodiscard]] point first() const noexcept;
 
     [[nodiscard]] point last() const noexcept;
 
+    [[nodiscard]] std::span<color const> pixels() const noexcept;
+
+    [[nodiscard]] draw_state_stats state_stats() const noexcept;
+
+    [[nodiscard]] frame_stats stats() const noexcept;
+
+    [[nodiscard]] texture_cache_stats cache_stats() const noexcept;
+
+    [[nodiscard]] std::span<rect const> damage() const noexcept;
+
+    [[nodiscard]] canvas_lock lock(rect const& r) noexcept;
+
     friend class texture;
 
+    friend class text;
+
+    friend class streaming_texture;
+
+    friend class atlas;
+
+    friend class target_guard;
+
     friend void render(canvas&) noexcept;
 
     friend void clear(canvas&, color const& col) noexcept;
@@ -324,13 +752,61 @@ public:
 
     friend void color_set(canvas&, color const&) noexcept;
 
-    friend void draw_point(canvas&, point const&) noexcept;
+    friend blend blend_get(canvas&) noexcept;
+
+    friend void blend_set(canvas&, blend) noexcept;
+
+    friend std::optional<rect> clip_get(canvas&) noexcept;
+
+    friend void clip_set(canvas&, rect const&) noexcept;
+
+    friend void clip_reset(canvas&) noexcept;
+
+    friend std::size_t upload_budget_get(canvas&) noexcept;
+
+    friend void upload_budget_set(canvas&, std::size_t) noexcept;
+
+    friend std::size_t cache_budget_get(canvas&) noexcept;
+
+    friend void cache_budget_set(canvas&, std::size_t) noexcept;
+
+    friend dedupe cache_dedupe_get(canvas&) noexcept;
+
+    friend void cache_dedupe_set(canvas&, dedupe) noexcept;
 
-    friend void draw_line(canvas&, point const&, point const&) noexcept;
+    friend redraw redraw_get(canvas&) noexcept;
 
-    friend void draw_circle(canvas&, point const&, int32_t, fill) noexcept;
+    friend void redraw_set(canvas&, redraw) noexcept;
 
-    friend void draw_rect(canvas&, point const&, vector const&, fill) noexcept;
+    friend void invalidate(canvas&, rect const&) noexcept;
+
+    friend void draw_point(canvas&, point const&, color const&) noexcept;
+
+    friend void draw_points(canvas&, std::span<point const>, color const&) noexcept;
+
+    friend void draw_points(canvas&, std::span<point const>, std::span<color const>) noexcept;
+
+    friend void draw_line(canvas&, point const&, point const&, color const&) noexcept;
+
+    friend void draw_lines(canvas&, std::span<point const>, color const&) noexcept;
+
+    friend void draw_lines(canvas&, std::span<point const>, std::span<color const>) noexcept;
+
+    friend void draw_polyline(canvas&, std::span<point const>, color const&) noexcept;
+
+    friend void draw_polyline(canvas&, std::span<point const>, std::span<color const>) noexcept;
+
+    friend void draw_ellipse(canvas&, point const&, vector const&, color const&, fill) noexcept;
+
+    friend void draw_rect(canvas&, point const&, vector const&, color const&, fill) noexcept;
+
+    friend void draw_rects(canvas&, std::span<rect const>, color const&, fill) noexcept;
+
+    friend void draw_rects(canvas&, std::span<rect const>, std::span<color const>, fill) noexcept;
+
+    friend void draw_gradient_rect(canvas&, point const&, vector const&, std::span<gradient_stop const>, float) noexcept;
+
+    friend void draw_gradient_circle(canvas&, point const&, int32_t, std::span<gradient_stop const>) noexcept;
 
     friend void draw_texture(canvas&, texture const&) noexcept;
 
@@ -345,32 +821,360 @@ public:
     friend void draw_text(canvas& can, std::string const& text, font const& f, point const& p) noexcept;
 
     friend void draw_text(canvas& can, std::string const& text, font const& f, point const& p, color const& col) noexcept;
+
+    friend void draw_text(canvas& can, text const& t, point const& p) noexcept;
+
+    friend void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p) noexcept;
+
+    friend void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p, vector const& size) noexcept;
+
+    friend void draw_sprites(canvas& can, atlas const& a, std::span<sprite const> ss, std::span<point const> ps) noexcept;
+};
+
+class canvas_lock
+{
+    void* canvas_handle_{};
+    pixel_view view_{};
+
+    canvas_lock(void* ch, pixel_view const& view) noexcept;
+
+public:
+    ~canvas_lock();
+
+    canvas_lock(canvas_lock const&) = delete;
+
+    canvas_lock& operator=(canvas_lock const&) = delete;
+
+    [[nodiscard]] pixel_view const& view() const noexcept;
+
+    friend class canvas;
+};
+
+class target_guard
+{
+    void* canvas_handle{};
+    void* previous{};
+
+public:
+    target_guard(canvas& can, texture& target) noexcept;
+
+    ~target_guard();
+
+    target_guard(target_guard const&) = delete;
+
+    target_guard& operator=(target_guard const&) = delete;
+};
+
+class readback
+{
+    struct slot
+    {
+        std::vector<color> pixels{};
+        rect area{};
+        uint64_t sequence{};
+    };
+
+    std::vector<slot> slots;
+    std::atomic<std::size_t> head{};
+    std::atomic<std::size_t> tail{};
+    uint64_t sequence{};
+
+public:
+    struct frame
+    {
+        rect area{};
+        uint64_t sequence{};
+        std::span<color const> pixels{};
+    };
+
+    explicit readback(std::size_t size = 3);
+
+    readback(readback const&) = delete;
+
+    readback& operator=(readback const&) = delete;
+
+    bool capture(canvas& can, rect const& r) noexcept;
+
+    [[nodiscard]] std::optional<frame> acquire() const noexcept;
+
+    void release() noexcept;
+};
+
+enum class event_type : uint32_t
+{
+    quit,
+    window_close,
+    window_resize,
+    key_down,
+    key_up,
+    mouse_motion,
+    mouse_down,
+    mouse_up,
+    mouse_wheel
+};
+
+struct event
+{
+    event_type type{};
+    std::chrono::milliseconds time{};
+    point pos{};
+    vector delta{};
+    int32_t key{};
+    int32_t scancode{};
+    uint16_t mods{};
+    uint8_t button{};
+    bool repeat{};
+    uint32_t coalesced{};
+
+    [[nodiscard]] friend constexpr bool operator==(event const& e0, event const& e1) = default;
+};
+
+struct event_stats
+{
+    uint64_t received{};
+    uint64_t queued{};
+    uint64_t coalesced{};
+    uint64_t dropped{};
+
+    [[nodiscard]] friend constexpr bool operator==(event_stats const& s0, event_stats const& s1) = default;
+};
+
+class events
+{
+    // A slot is free for the producer when its sequence equals the write position, and holds an event for the
+    // consumers when it equals the read position plus one
+    struct alignas(64) slot
+    {
+        std::atomic<std::size_t> sequence{};
+        event ev{};
+    };
+
+    std::unique_ptr<slot[]> slots;
+    std::size_t mask{};
+    std::size_t head{};
+    alignas(64) std::atomic<std::size_t> tail{};
+    alignas(64) std::atomic<uint64_t> received{};
+    std::atomic<uint64_t> queued{};
+    std::atomic<uint64_t> coalesced{};
+    std::atomic<uint64_t> dropped{};
+
+public:
+    explicit events(std::size_t size = 1024);
+
+    events(events const&) = delete;
+
+    events& operator=(events const&) = delete;
+
+    std::size_t pump() noexcept;
+
+    bool push(event const& e) noexcept;
+
+    [[nodiscard]] std::optional<event> poll() noexcept;
+
+    std::size_t poll(std::span<event> out) noexcept;
+
+    [[nodiscard]] event_stats stats() const noexcept;
+};
+
+class command_buffer
+{
+    std::vector<std::byte> data{};
+    std::size_t count{};
+
+public:
+    command_buffer() = default;
+
+    explicit command_buffer(std::size_t bytes);
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    [[nodiscard]] std::size_t bytes() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    void reset() noexcept;
+
+    friend struct command_stream;
+};
+
+class command_queue
+{
+    // Each lane is written by one thread only, and is kept on its own cache line
+    struct alignas(64) lane
+    {
+        command_buffer buffer{};
+    };
+
+    std::vector<lane> lanes;
+
+public:
+    explicit command_queue(std::size_t threads, std::size_t bytes = 0);
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    [[nodiscard]] command_buffer& operator[](std::size_t thread) noexcept;
+
+    [[nodiscard]] command_buffer const& operator[](std::size_t thread) const noexcept;
+};
+
+enum class pacing
+{
+    throughput,
+    low_latency
+};
+
+struct pacer_clock
+{
+    std::function<std::chrono::nanoseconds()> now{};
+    std::function<void(std::chrono::nanoseconds)> sleep{};
+    std::function<void(std::chrono::nanoseconds)> yield{};
+};
+
+struct pacer_stats
+{
+    uint64_t frames{};
+    uint64_t missed{};
+    double jitter_ms{};
+    double jitter_max_ms{};
+    double work_ms{};
+
+    [[nodiscard]] friend constexpr bool operator==(pacer_stats const& s0, pacer_stats const& s1) = default;
+};
+
+class frame_pacer
+{
+    pacer_clock clock_{};
+    std::chrono::nanoseconds period_{};
+    std::chrono::nanoseconds spin_{};
+    pacing mode_{};
+    bool started_{};
+    std::chrono::nanoseconds deadline_{};
+    std::chrono::nanoseconds woke_{};
+    std::chrono::nanoseconds work_{};
+    double jitter_sum_ms_{};
+    uint64_t jitter_samples_{};
+    pacer_stats stats_{};
+
+    void wait_until(std::chrono::nanoseconds t) noexcept;
+
+    void jitter_add(std::chrono::nanoseconds error) noexcept;
+
+    void frame_end() noexcept;
+
+public:
+    explicit frame_pacer(double fps, pacing mode = pacing::throughput, pacer_clock clock = {}) noexcept;
+
+    [[nodiscard]] double fps() const noexcept;
+
+    void fps_set(double fps) noexcept;
+
+    [[nodiscard]] pacing mode() const noexcept;
+
+    void mode_set(pacing mode) noexcept;
+
+    [[nodiscard]] std::chrono::nanoseconds spin() const noexcept;
+
+    void spin_set(std::chrono::nanoseconds spin) noexcept;
+
+    [[nodiscard]] pacer_stats stats() const noexcept;
+
+    void reset() noexcept;
+
+    friend void render(canvas& can, frame_pacer& fp) noexcept;
 };
 
 void render(canvas& can) noexcept;
 
+void render(canvas& can, command_queue& q) noexcept;
+
+void render(canvas& can, frame_pacer& fp) noexcept;
+
 void clear(canvas& can, color const& col = black) noexcept;
 
 [[nodiscard]] color color_get(canvas& can) noexcept;
 
 void color_set(canvas& can, color const& col) noexcept;
 
+[[nodiscard]] blend blend_get(canvas& can) noexcept;
+
+void blend_set(canvas& can, blend b) noexcept;
+
+[[nodiscard]] std::optional<rect> clip_get(canvas& can) noexcept;
+
+void clip_set(canvas& can, rect const& r) noexcept;
+
+void clip_reset(canvas& can) noexcept;
+
+[[nodiscard]] std::size_t upload_budget_get(canvas& can) noexcept;
+
+void upload_budget_set(canvas& can, std::size_t bytes) noexcept;
+
+[[nodiscard]] std::size_t cache_budget_get(canvas& can) noexcept;
+
+void cache_budget_set(canvas& can, std::size_t bytes) noexcept;
+
+[[nodiscard]] dedupe cache_dedupe_get(canvas& can) noexcept;
+
+void cache_dedupe_set(canvas& can, dedupe d) noexcept;
+
+[[nodiscard]] redraw redraw_get(canvas& can) noexcept;
+
+void redraw_set(canvas& can, redraw r) noexcept;
+
+void invalidate(canvas& can, rect const& r) noexcept;
+
 void draw_point(canvas& can, point const& p) noexcept;
 
 void draw_point(canvas& can, point const& p, color const& c) noexcept;
 
+void draw_points(canvas& can, std::span<point const> ps) noexcept;
+
+void draw_points(canvas& can, std::span<point const> ps, color const& col) noexcept;
+
+void draw_points(canvas& can, std::span<point const> ps, std::span<color const> cols) noexcept;
+
 void draw_line(canvas& can, point const& p0, point const& p1) noexcept;
 
 void draw_line(canvas& can, point const& p0, point const& p1, color const& col) noexcept;
 
+void draw_lines(canvas& can, std::span<point const> ps) noexcept;
+
+void draw_lines(canvas& can, std::span<point const> ps, color const& col) noexcept;
+
+void draw_lines(canvas& can, std::span<point const> ps, std::span<color const> cols) noexcept;
+
+void draw_polyline(canvas& can, std::span<point const> ps) noexcept;
+
+void draw_polyline(canvas& can, std::span<point const> ps, color const& col) noexcept;
+
+void draw_polyline(canvas& can, std::span<point const> ps, std::span<color const> cols) noexcept;
+
 void draw_circle(canvas& can, point const& center, int32_t radius, fill f = fill::off) noexcept;
 
 void draw_circle(canvas& can, point const& center, int32_t radius, color const& col, fill f = fill::off) noexcept;
 
+void draw_ellipse(canvas& can, point const& center, vector const& radii, fill f = fill::off) noexcept;
+
+void draw_ellipse(canvas& can, point const& center, vector const& radii, color const& col, fill f = fill::off) noexcept;
+
 void draw_rect(canvas& can, point const& p, vector const& v, fill f = fill::off) noexcept;
 
 void draw_rect(canvas& can, point const& p, vector const& v, color const& col, fill f = fill::off) noexcept;
 
+void draw_rects(canvas& can, std::span<rect const> rs, fill f = fill::off) noexcept;
+
+void draw_rects(canvas& can, std::span<rect const> rs, color const& col, fill f = fill::off) noexcept;
+
+void draw_rects(canvas& can, std::span<rect const> rs, std::span<color const> cols, fill f = fill::off) noexcept;
+
+void draw_gradient_rect(canvas& can, point const& p, vector const& v, std::span<gradient_stop const> stops, float angle = 0.f) noexcept;
+
+void draw_gradient_rect(canvas& can, point const& p, vector const& v, color const& c0, color const& c1, float angle = 0.f) noexcept;
+
+void draw_gradient_circle(canvas& can, point const& center, int32_t radius, std::span<gradient_stop const> stops) noexcept;
+
+void draw_gradient_circle(canvas& can, point const& center, int32_t radius, color const& c0, color const& c1) noexcept;
+
 void draw_texture(canvas& can, texture const& tex) noexcept;
 
 void draw_texture(canvas& can, texture const& tex, point const& p) noexcept;
@@ -383,6 +1187,102 @@ void draw_text(canvas& can, std::string const& text, font const& f, point const&
 
 void draw_text(canvas& can, std::string const& text, font const& f, point const& p, color const& col) noexcept;
 
+void draw_text(canvas& can, text const& t, point const& p) noexcept;
+
+void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p) noexcept;
+
+void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p, vector const& size) noexcept;
+
+void draw_sprites(canvas& can, atlas const& a, std::span<sprite const> ss, std::span<point const> ps) noexcept;
+
+void draw_stats(canvas& can, font const& f, point const& p) noexcept;
+
+void submit(canvas& can, command_buffer const& cb) noexcept;
+
+void submit(canvas& can, command_queue& q) noexcept;
+
+void clear(command_buffer& cb, color const& col = black) noexcept;
+
+void color_set(command_buffer& cb, color const& col) noexcept;
+
+void blend_set(command_buffer& cb, blend b) noexcept;
+
+void clip_set(command_buffer& cb, rect const& r) noexcept;
+
+void clip_reset(command_buffer& cb) noexcept;
+
+void draw_point(command_buffer& cb, point const& p) noexcept;
+
+void draw_point(command_buffer& cb, point const& p, color const& c) noexcept;
+
+void draw_points(command_buffer& cb, std::span<point const> ps) noexcept;
+
+void draw_points(command_buffer& cb, std::span<point const> ps, color const& col) noexcept;
+
+void draw_points(command_buffer& cb, std::span<point const> ps, std::span<color const> cols) noexcept;
+
+void draw_line(command_buffer& cb, point const& p0, point const& p1) noexcept;
+
+void draw_line(command_buffer& cb, point const& p0, point const& p1, color const& col) noexcept;
+
+void draw_lines(command_buffer& cb, std::span<point const> ps) noexcept;
+
+void draw_lines(command_buffer& cb, std::span<point const> ps, color const& col) noexcept;
+
+void draw_lines(command_buffer& cb, std::span<point const> ps, std::span<color const> cols) noexcept;
+
+void draw_polyline(command_buffer& cb, std::span<point const> ps) noexcept;
+
+void draw_polyline(command_buffer& cb, std::span<point const> ps, color const& col) noexcept;
+
+void draw_polyline(command_buffer& cb, std::span<point const> ps, std::span<color const> cols) noexcept;
+
+void draw_circle(command_buffer& cb, point const& center, int32_t radius, fill f = fill::off) noexcept;
+
+void draw_circle(command_buffer& cb, point const& center, int32_t radius, color const& col, fill f = fill::off) noexcept;
+
+void draw_ellipse(command_buffer& cb, point const& center, vector const& radii, fill f = fill::off) noexcept;
+
+void draw_ellipse(command_buffer& cb, point const& center, vector const& radii, color const& col, fill f = fill::off) noexcept;
+
+void draw_rect(command_buffer& cb, point const& p, vector const& v, fill f = fill::off) noexcept;
+
+void draw_rect(command_buffer& cb, point const& p, vector const& v, color const& col, fill f = fill::off) noexcept;
+
+void draw_rects(command_buffer& cb, std::span<rect const> rs, fill f = fill::off) noexcept;
+
+void draw_rects(command_buffer& cb, std::span<rect const> rs, color const& col, fill f = fill::off) noexcept;
+
+void draw_rects(command_buffer& cb, std::span<rect const> rs, std::span<color const> cols, fill f = fill::off) noexcept;
+
+void draw_gradient_rect(command_buffer& cb, point const& p, vector const& v, std::span<gradient_stop const> stops, float angle = 0.f) noexcept;
+
+void draw_gradient_rect(command_buffer& cb, point const& p, vector const& v, color const& c0, color const& c1, float angle = 0.f) noexcept;
+
+void draw_gradient_circle(command_buffer& cb, point const& center, int32_t radius, std::span<gradient_stop const> stops) noexcept;
+
+void draw_gradient_circle(command_buffer& cb, point const& center, int32_t radius, color const& c0, color const& c1) noexcept;
+
+void draw_texture(command_buffer& cb, texture const& tex) noexcept;
+
+void draw_texture(command_buffer& cb, texture const& tex, point const& p) noexcept;
+
+void draw_texture(command_buffer& cb, texture const& tex, point const& p, vector const& s) noexcept;
+
+void draw_texture(command_buffer& cb, texture const& tex, point const& p, vector const& s, point const& tp, vector const& ts) noexcept;
+
+void draw_text(command_buffer& cb, std::string const& text, font const& f, point const& p) noexcept;
+
+void draw_text(command_buffer& cb, std::string const& text, font const& f, point const& p, color const& col) noexcept;
+
+void draw_text(command_buffer& cb, text const& t, point const& p) noexcept;
+
+void draw_sprite(command_buffer& cb, atlas const& a, sprite const& s, point const& p) noexcept;
+
+void draw_sprite(command_buffer& cb, atlas const& a, sprite const& s, point const& p, vector const& size) noexcept;
+
+void draw_sprites(command_buffer& cb, atlas const& a, std::span<sprite const> ss, std::span<point const> ps) noexcept;
+
 }
 
 }
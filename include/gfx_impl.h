@@ -13,9 +13,14 @@ It is also recommended that you include a file called COPYING (or COPYING.txt) c
 */
 #pragma once
 
+#include <cstddef>
 #include <filesystem>
+#include <functional>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace gfx {
 
@@ -27,6 +32,25 @@ struct vector;
 
 struct color;
 
+struct rect;
+
+struct sprite;
+
+struct glyph_atlas_stats;
+
+struct font_library_stats;
+
+struct draw_state_stats;
+
+struct frame_stats;
+
+struct texture_cache_stats;
+
+struct event;
+
+template<typename T>
+struct basic_pixel_view;
+
 class texture;
 
 enum class visibility;
@@ -35,12 +59,28 @@ enum class vsync;
 
 enum class fill;
 
+enum class blend;
+
+enum class dedupe;
+
+enum class redraw;
+
 namespace impl {
 
 void global_context_destroy() noexcept;
 
 void global_context_create() noexcept;
 
+std::optional<rect> rects_intersection(rect const& a, rect const& b) noexcept;
+
+rect rects_union(rect const& a, rect const& b) noexcept;
+
+void rects_merge(std::vector<rect>& rs, rect const& r, std::size_t max) noexcept;
+
+std::optional<std::span<std::byte const>> file_map(std::filesystem::path const& path) noexcept;
+
+void file_unmap(std::span<std::byte const> bytes) noexcept;
+
 void window_destroy(void* handle) noexcept;
 
 void* window_create(point pos, vector size, std::string const& title, visibility vis) noexcept;
@@ -49,35 +89,149 @@ void window_show(void* handle) noexcept;
 
 void window_hide(void* handle) noexcept;
 
+bool event_next(event& e) noexcept;
+
 void texture_destroy(void* handle) noexcept;
 
 void* texture_load(void* handle, std::filesystem::path const& path) noexcept;
 
+void* texture_load(void* handle, std::span<std::byte const> bytes) noexcept;
+
 vector texture_size(void* handle) noexcept;
 
+void* texture_create_streaming(void* handle, vector size) noexcept;
+
+void* texture_create_target(void* handle, vector size) noexcept;
+
+void texture_update(void* canvas_handle, void* handle, rect const& r, color const* pixels, int32_t pitch) noexcept;
+
+void* texture_load_cached(void* handle, std::filesystem::path const& path) noexcept;
+
+void texture_load_async(void* handle, std::filesystem::path const& path, std::function<void(void*)> done) noexcept;
+
+void* text_texture_create(void* handle, std::string const& text, void* font_handle, color const& col) noexcept;
+
+void atlas_destroy(void* handle) noexcept;
+
+void* atlas_create(void* canvas_handle, vector page_size) noexcept;
+
+std::optional<sprite> atlas_add(void* handle, std::filesystem::path const& path) noexcept;
+
+std::optional<sprite> atlas_add(void* handle, std::span<std::byte const> bytes) noexcept;
+
+std::optional<sprite> atlas_add(void* handle, std::span<color const> pixels, vector size) noexcept;
+
+std::size_t atlas_pages(void* handle) noexcept;
+
 void font_destroy(void* handle) noexcept;
 
-void* font_create(std::filesystem::path const& path, int32_t size) noexcept;
+void* font_share(void* handle) noexcept;
+
+void* font_create(std::span<std::byte const> bytes, int32_t size) noexcept;
+
+vector font_text_size(void* handle, std::string_view text) noexcept;
+
+void font_text_sizes(void* handle, std::span<std::string_view const> texts, std::span<vector> out) noexcept;
+
+glyph_atlas_stats font_atlas_stats(void* handle) noexcept;
+
+void font_library_destroy(void* handle) noexcept;
+
+void* font_library_create() noexcept;
+
+void* font_library_default() noexcept;
 
-vector font_text_size(void* handle, char const* text) noexcept;
+void* font_library_load(void* handle, std::filesystem::path const& path, int32_t size) noexcept;
+
+font_library_stats font_library_stats_get(void* handle) noexcept;
 
 void canvas_destroy(void* handle) noexcept;
 
 void* canvas_create(void* window_handle, vsync vs) noexcept;
 
+void* canvas_create_headless(vector size) noexcept;
+
+std::span<color const> canvas_pixels(void* handle) noexcept;
+
 color canvas_color_pick(void* handle, point const& p) noexcept;
 
+bool canvas_read_pixels(void* handle, rect const& r, std::span<color> out) noexcept;
+
 vector canvas_size(void* handle) noexcept;
 
 color canvas_color_get(void* handle) noexcept;
 
 void canvas_color_set(void* handle, color const& col) noexcept;
 
-void canvas_draw_point(void* handle, point const& p) noexcept;
+blend canvas_blend_get(void* handle) noexcept;
+
+void canvas_blend_set(void* handle, blend b) noexcept;
+
+std::optional<rect> canvas_clip_get(void* handle) noexcept;
+
+void canvas_clip_set(void* handle, std::optional<rect> const& r) noexcept;
+
+draw_state_stats canvas_state_stats(void* handle) noexcept;
+
+frame_stats canvas_stats(void* handle) noexcept;
+
+void* canvas_target_get(void* handle) noexcept;
+
+void canvas_target_set(void* handle, void* texture_handle) noexcept;
+
+texture_cache_stats canvas_cache_stats(void* handle) noexcept;
+
+std::size_t canvas_cache_budget_get(void* handle) noexcept;
+
+void canvas_cache_budget_set(void* handle, std::size_t bytes) noexcept;
+
+dedupe canvas_cache_dedupe_get(void* handle) noexcept;
+
+void canvas_cache_dedupe_set(void* handle, dedupe d) noexcept;
+
+std::size_t canvas_upload_budget_get(void* handle) noexcept;
+
+void canvas_upload_budget_set(void* handle, std::size_t bytes) noexcept;
+
+redraw canvas_redraw_get(void* handle) noexcept;
 
-void canvas_draw_rect(void* handle, point const& p, vector const& v, fill f) noexcept;
+void canvas_redraw_set(void* handle, redraw r) noexcept;
 
-void canvas_draw_line(void* handle, point const& p0, point const& p1) noexcept;
+void canvas_invalidate(void* handle, rect const& r) noexcept;
+
+std::span<rect const> canvas_damage(void* handle) noexcept;
+
+basic_pixel_view<color> canvas_lock(void* handle, rect const& r) noexcept;
+
+void canvas_unlock(void* handle) noexcept;
+
+void canvas_draw_point(void* handle, point const& p, color const& col) noexcept;
+
+void canvas_draw_points(void* handle, std::span<point const> ps, color const& col) noexcept;
+
+void canvas_draw_points(void* handle, std::span<point const> ps, std::span<color const> cols) noexcept;
+
+void canvas_draw_rect(void* handle, point const& p, vector const& v, color const& col, fill f) noexcept;
+
+void canvas_draw_rects(void* handle, std::span<rect const> rs, color const& col, fill f) noexcept;
+
+void canvas_draw_rects(void* handle, std::span<rect const> rs, std::span<color const> cols, fill f) noexcept;
+
+void canvas_draw_line(void* handle, point const& p0, point const& p1, color const& col) noexcept;
+
+void canvas_draw_lines(void* handle, std::span<point const> ps, color const& col) noexcept;
+
+void canvas_draw_lines(void* handle, std::span<point const> ps, std::span<color const> cols) noexcept;
+
+void canvas_draw_polyline(void* handle, std::span<point const> ps, color const& col) noexcept;
+
+void canvas_draw_polyline(void* handle, std::span<point const> ps, std::span<color const> cols) noexcept;
+
+std::span<color> canvas_scratch_pixels(void* handle, vector size) noexcept;
+
+void canvas_draw_scratch_pixels(void* handle, vector size, rect const& dst) noexcept;
+
+void canvas_draw_scratch_pixels(void* handle, vector size, point const& p, std::span<rect const> spans) noexcept;
 
 void canvas_draw_texture(void* handle, void* texture_handle) noexcept;
 
@@ -87,6 +241,8 @@ void canvas_draw_texture(void* handle, void* texture_handle, point const& p, vec
 
 void canvas_draw_texture(void* handle, void* texture_handle, point const& p, vector const& s, point const& tp, vector const& ts) noexcept;
 
+void canvas_draw_sprites(void* handle, void* atlas_handle, std::span<sprite const> ss, std::span<point const> ps, std::span<vector const> sizes) noexcept;
+
 void canvas_draw_text(void* handle, std::string const& text, void* font_handle, point const& p, color const& col) noexcept;
 
 void canvas_render(void* handle) noexcept;
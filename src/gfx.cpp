@@ -14,14 +14,37 @@ It is also recommended that you include a file called COPYING (or COPYING.txt) c
 #include "gfx.h"
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <numbers>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "gfx_impl.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define GFX_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GFX_HAS_AVX2
+#include <immintrin.h>
+#endif
+
 namespace {
 
 struct gfx_global
@@ -43,336 +66,2443 @@ struct gfx_global
 
 gfx_global gfx_global_context;
 
-float srgb2linear(float x)
+constexpr float srgb2linear(float x) noexcept
 {
     return x * (x * (x * 0.30530611f + 0.682171111f) + 0.012522878f);
 }
 
-float linear2srgb(float x)
+// Square root usable in constant expressions, converges from above with Newton's method
+constexpr float sqrt_c(float x) noexcept
 {
-    float s0 = sqrtf(x);
-    float s1 = sqrtf(s0);
-    float s2 = sqrtf(s1);
-    return std::clamp(0.662002687f * s0 + 0.684122060f * s1 - 0.323583601f * s2 - 0.0225411470f * x, 0.f, 1.f);
+    if (x <= 0.f) {
+        return 0.f;
+    }
+    double r = x < 1.f ? 1.0 : double(x);
+    for (;;) {
+        double next = 0.5 * (r + double(x) / r);
+        if (next >= r) {
+            return static_cast<float>(r);
+        }
+        r = next;
+    }
 }
 
-uint8_t blend_component(float x, float y, float fraction)
+constexpr float linear2srgb(float x) noexcept
 {
-    return static_cast<uint8_t>(linear2srgb(srgb2linear(float(x) / 256.f) * fraction + srgb2linear(float(y) / 256.f) * (1 - fraction)) * 256.f);
+    float s0 = sqrt_c(x);
+    float s1 = sqrt_c(s0);
+    float s2 = sqrt_c(s1);
+    return std::clamp(0.662002687f * s0 + 0.684122060f * s1 - 0.323583601f * s2 - 0.0225411470f * x, 0.f, 1.f);
 }
 
+// Linear intensity of each 8-bit sRGB value
+constexpr auto srgb2linear_table = [] {
+    std::array<float, 256> table{};
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        table[i] = srgb2linear(float(i) / 256.f);
+    }
+    return table;
+}();
+
+// Smallest linear intensity that maps to each 8-bit sRGB value, found by bisection over the float representation
+constexpr auto linear2srgb_table = [] {
+    std::array<float, 256> table{};
+    for (std::size_t i = 1; i < table.size(); ++i) {
+        uint32_t lo = 0;
+        uint32_t hi = std::bit_cast<uint32_t>(1.f);
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (linear2srgb(std::bit_cast<float>(mid)) * 256.f >= float(i)) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        table[i] = std::bit_cast<float>(lo);
+    }
+    return table;
+}();
+
+constexpr uint8_t linear2srgb8(float x) noexcept
+{
+    std::size_t i = 0;
+    for (std::size_t step = 128; step > 0; step /= 2) {
+        i += x >= linear2srgb_table[i + step] ? step : 0;
+    }
+    return static_cast<uint8_t>(i);
 }
 
-namespace gfx {
+constexpr uint8_t blend_component(uint8_t x, uint8_t y, float fraction) noexcept
+{
+    return linear2srgb8(srgb2linear_table[x] * fraction + srgb2linear_table[y] * (1 - fraction));
+}
 
-namespace v0 {
+constexpr uint8_t blend_alpha(uint8_t x, uint8_t y, float fraction) noexcept
+{
+    return static_cast<uint8_t>(((float(x) / 256.f) * fraction + (float(y) / 256.f) * (1 - fraction)) * 256.f);
+}
 
-color color_blend(color c0, color c1, float fraction) noexcept
+constexpr gfx::color blend_color(gfx::color c0, gfx::color c1, float fraction) noexcept
 {
     return {
         blend_component(c0.r, c1.r, fraction),
         blend_component(c0.g, c1.g, fraction),
         blend_component(c0.b, c1.b, fraction),
-        static_cast<uint8_t>(((float(c0.a) / 256.f) * fraction + (float(c1.a) / 256.f) * (1 - fraction)) * 256.f)
+        blend_alpha(c0.a, c1.a, fraction)
     };
 }
 
-window::~window()
+void blend_scalar(gfx::color const* c0, gfx::color const* c1, float const* fractions, gfx::color* out, std::size_t n) noexcept
 {
-    impl::window_destroy(handle);
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = blend_color(c0[i], c1[i], fractions[i]);
+    }
 }
 
-window::window(point pos, vector size, std::string const& title, visibility vis) noexcept
-    : handle{impl::window_create(pos, size, title, vis)}
-{}
+#if defined(GFX_HAS_SSE2)
 
-window& window::operator=(window&& rhs) noexcept
+// One pixel per vector with the components in the lanes, alpha is blended without gamma correction
+__m128 blend_pixel_sse2(__m128 x, __m128 y, float fraction) noexcept
 {
-    auto* temp = rhs.handle;
-    rhs.handle = nullptr;
-    impl::window_destroy(handle);
-    handle = temp;
-    return *this;
+    auto const scale = _mm_set1_ps(1.f / 256.f);
+    auto const f0 = _mm_set1_ps(fraction);
+    auto const f1 = _mm_set1_ps(1 - fraction);
+    x = _mm_mul_ps(x, scale);
+    y = _mm_mul_ps(y, scale);
+
+    auto const lx = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.30530611f)), _mm_set1_ps(0.682171111f))), _mm_set1_ps(0.012522878f)));
+    auto const ly = _mm_mul_ps(y, _mm_add_ps(_mm_mul_ps(y, _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(0.30530611f)), _mm_set1_ps(0.682171111f))), _mm_set1_ps(0.012522878f)));
+    auto const l = _mm_add_ps(_mm_mul_ps(lx, f0), _mm_mul_ps(ly, f1));
+
+    auto const s0 = _mm_sqrt_ps(l);
+    auto const s1 = _mm_sqrt_ps(s0);
+    auto const s2 = _mm_sqrt_ps(s1);
+    auto srgb = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.662002687f), s0), _mm_mul_ps(_mm_set1_ps(0.684122060f), s1));
+    srgb = _mm_sub_ps(srgb, _mm_mul_ps(_mm_set1_ps(0.323583601f), s2));
+    srgb = _mm_sub_ps(srgb, _mm_mul_ps(_mm_set1_ps(0.0225411470f), l));
+    srgb = _mm_min_ps(_mm_max_ps(srgb, _mm_setzero_ps()), _mm_set1_ps(1.f));
+
+    auto const alpha = _mm_add_ps(_mm_mul_ps(x, f0), _mm_mul_ps(y, f1));
+    auto const mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    return _mm_mul_ps(_mm_or_ps(_mm_and_ps(mask, alpha), _mm_andnot_ps(mask, srgb)), _mm_set1_ps(256.f));
 }
 
-void window::show() noexcept
+void blend_sse2(gfx::color const* c0, gfx::color const* c1, float const* fractions, gfx::color* out, std::size_t n) noexcept
 {
-    impl::window_show(handle);
+    auto const zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(c0 + i));
+        auto const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(c1 + i));
+        auto const a_lo = _mm_unpacklo_epi8(a, zero);
+        auto const a_hi = _mm_unpackhi_epi8(a, zero);
+        auto const b_lo = _mm_unpacklo_epi8(b, zero);
+        auto const b_hi = _mm_unpackhi_epi8(b, zero);
+
+        auto const r0 = _mm_cvttps_epi32(blend_pixel_sse2(_mm_cvtepi32_ps(_mm_unpacklo_epi16(a_lo, zero)), _mm_cvtepi32_ps(_mm_unpacklo_epi16(b_lo, zero)), fractions[i]));
+        auto const r1 = _mm_cvttps_epi32(blend_pixel_sse2(_mm_cvtepi32_ps(_mm_unpackhi_epi16(a_lo, zero)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(b_lo, zero)), fractions[i + 1]));
+        auto const r2 = _mm_cvttps_epi32(blend_pixel_sse2(_mm_cvtepi32_ps(_mm_unpacklo_epi16(a_hi, zero)), _mm_cvtepi32_ps(_mm_unpacklo_epi16(b_hi, zero)), fractions[i + 2]));
+        auto const r3 = _mm_cvttps_epi32(blend_pixel_sse2(_mm_cvtepi32_ps(_mm_unpackhi_epi16(a_hi, zero)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(b_hi, zero)), fractions[i + 3]));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3)));
+    }
+    blend_scalar(c0 + i, c1 + i, fractions + i, out + i, n - i);
 }
 
-void window::hide() noexcept
+#endif
+
+#if defined(GFX_HAS_AVX2)
+
+// Two pixels per vector, one in each 128-bit half
+__attribute__((target("avx2"))) __m256 blend_pixels_avx2(__m256 x, __m256 y, float fraction0, float fraction1) noexcept
 {
-    impl::window_hide(handle);
+    auto const scale = _mm256_set1_ps(1.f / 256.f);
+    auto const f0 = _mm256_setr_ps(fraction0, fraction0, fraction0, fraction0, fraction1, fraction1, fraction1, fraction1);
+    auto const f1 = _mm256_sub_ps(_mm256_set1_ps(1.f), f0);
+    x = _mm256_mul_ps(x, scale);
+    y = _mm256_mul_ps(y, scale);
+
+    auto const lx = _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.30530611f)), _mm256_set1_ps(0.682171111f))), _mm256_set1_ps(0.012522878f)));
+    auto const ly = _mm256_mul_ps(y, _mm256_add_ps(_mm256_mul_ps(y, _mm256_add_ps(_mm256_mul_ps(y, _mm256_set1_ps(0.30530611f)), _mm256_set1_ps(0.682171111f))), _mm256_set1_ps(0.012522878f)));
+    auto const l = _mm256_add_ps(_mm256_mul_ps(lx, f0), _mm256_mul_ps(ly, f1));
+
+    auto const s0 = _mm256_sqrt_ps(l);
+    auto const s1 = _mm256_sqrt_ps(s0);
+    auto const s2 = _mm256_sqrt_ps(s1);
+    auto srgb = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.662002687f), s0), _mm256_mul_ps(_mm256_set1_ps(0.684122060f), s1));
+    srgb = _mm256_sub_ps(srgb, _mm256_mul_ps(_mm256_set1_ps(0.323583601f), s2));
+    srgb = _mm256_sub_ps(srgb, _mm256_mul_ps(_mm256_set1_ps(0.0225411470f), l));
+    srgb = _mm256_min_ps(_mm256_max_ps(srgb, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+
+    auto const alpha = _mm256_add_ps(_mm256_mul_ps(x, f0), _mm256_mul_ps(y, f1));
+    auto const mask = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+    return _mm256_mul_ps(_mm256_blendv_ps(srgb, alpha, mask), _mm256_set1_ps(256.f));
 }
 
-texture::~texture()
+__attribute__((target("avx2"))) void blend_avx2(gfx::color const* c0, gfx::color const* c1, float const* fractions, gfx::color* out, std::size_t n) noexcept
 {
-    impl::texture_destroy(handle);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i r[4];
+        for (std::size_t k = 0; k < 4; ++k) {
+            auto const a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(c0 + i + 2 * k))));
+            auto const b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(c1 + i + 2 * k))));
+            r[k] = _mm256_cvttps_epi32(blend_pixels_avx2(a, b, fractions[i + 2 * k], fractions[i + 2 * k + 1]));
+        }
+        // Packing works within 128-bit halves, so the pixels come out as 0 2 4 6 1 3 5 7 and are put back in order
+        auto const packed = _mm256_packus_epi16(_mm256_packs_epi32(r[0], r[1]), _mm256_packs_epi32(r[2], r[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+    }
+    blend_scalar(c0 + i, c1 + i, fractions + i, out + i, n - i);
 }
 
-texture& texture::operator=(texture&& rhs) noexcept
+#endif
+
+using blend_kernel = void (*)(gfx::color const*, gfx::color const*, float const*, gfx::color*, std::size_t) noexcept;
+
+blend_kernel blend_kernel_select() noexcept
 {
-    auto* temp = rhs.handle;
-    rhs.handle = nullptr;
-    impl::texture_destroy(handle);
-    handle = temp;
-    return *this;
+#if defined(GFX_HAS_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return blend_avx2;
+    }
+#endif
+#if defined(GFX_HAS_SSE2)
+    return blend_sse2;
+#else
+    return blend_scalar;
+#endif
 }
 
-[[nodiscard]] vector texture::size() const noexcept
+blend_kernel const blend_batch = blend_kernel_select();
+
+// Alpha blending of rows of pixels, as SDL blends with blend::alpha: every component is src * a + dst * (1 - a), where
+// the source alpha counts as fully opaque. Division by 255 is rounded.
+constexpr uint8_t div255(uint32_t x) noexcept
 {
-    return impl::texture_size(handle);
+    x += 128;
+    return static_cast<uint8_t>((x + (x >> 8)) >> 8);
 }
 
-[[nodiscard]] std::optional<texture>
-texture::load(canvas& can, std::filesystem::path const& path) noexcept
+void blend_row_scalar(gfx::color* dst, gfx::color const* src, std::size_t n) noexcept
 {
-    void* tp = impl::texture_load(can.handle, path);
-    if (tp == nullptr) {
-        return {};
-    } else {
-        return texture{tp};
+    for (std::size_t i = 0; i < n; ++i) {
+        auto const a = uint32_t{src[i].a};
+        auto& d = dst[i];
+        d = {div255(src[i].r * a + d.r * (255 - a)), div255(src[i].g * a + d.g * (255 - a)), div255(src[i].b * a + d.b * (255 - a)), div255(255 * a + d.a * (255 - a))};
     }
 }
 
-font::~font()
+// Color keys compare the color components only
+constexpr uint32_t rgb_mask = std::endian::native == std::endian::little ? 0x00ffffffu : 0xffffff00u;
+
+void keyed_row_scalar(gfx::color* dst, gfx::color const* src, std::size_t n, gfx::color key) noexcept
 {
-    impl::font_destroy(handle);
+    auto const k = std::bit_cast<uint32_t>(key) & rgb_mask;
+    for (std::size_t i = 0; i < n; ++i) {
+        if ((std::bit_cast<uint32_t>(src[i]) & rgb_mask) != k) {
+            dst[i] = src[i];
+        }
+    }
 }
 
-font& font::operator=(font&& rhs) noexcept
+#if defined(GFX_HAS_SSE2)
+
+// Two pixels of 16-bit components
+__m128i blend_half_sse2(__m128i s, __m128i d) noexcept
 {
-    auto* temp = rhs.handle;
-    rhs.handle = nullptr;
-    impl::font_destroy(handle);
-    handle = temp;
-    return *this;
+    auto const a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    auto const opaque = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    auto const x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_or_si128(s, opaque), a), _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a))), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
 }
 
-[[nodiscard]] std::optional<font>
-font::load(std::filesystem::path const& path, int32_t size) noexcept
+void blend_row_sse2(gfx::color* dst, gfx::color const* src, std::size_t n) noexcept
 {
-    void* fp = impl::font_create(path.c_str(), size);
-    if (fp == nullptr) {
-        return {};
-    } else {
-        return font{fp};
+    auto const zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto const d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + i));
+        auto const lo = blend_half_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        auto const hi = blend_half_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
     }
+    blend_row_scalar(dst + i, src + i, n - i);
 }
 
-[[nodiscard]] vector
-font::text_size(font& f, char const* text) noexcept
+void keyed_row_sse2(gfx::color* dst, gfx::color const* src, std::size_t n, gfx::color key) noexcept
 {
-    return impl::font_text_size(f.handle, text);
+    auto const mask = _mm_set1_epi32(static_cast<int32_t>(rgb_mask));
+    auto const k = _mm_set1_epi32(static_cast<int32_t>(std::bit_cast<uint32_t>(key) & rgb_mask));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto const d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + i));
+        auto const keyed = _mm_cmpeq_epi32(_mm_and_si128(s, mask), k);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_and_si128(keyed, d), _mm_andnot_si128(keyed, s)));
+    }
+    keyed_row_scalar(dst + i, src + i, n - i, key);
 }
 
-[[nodiscard]] vector
-font::text_size(font& f, std::string const& text) noexcept
+#endif
+
+#if defined(GFX_HAS_AVX2)
+
+// Four pixels of 16-bit components, two in each 128-bit half
+__attribute__((target("avx2"))) __m256i blend_half_avx2(__m256i s, __m256i d) noexcept
 {
-    return text_size(f, text.c_str());
+    auto const a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    auto const opaque = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+    auto const x = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_or_si256(s, opaque), a), _mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(255), a))), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
 }
 
-canvas::~canvas()
+// Unpacking and packing both work within 128-bit halves, so the pixels stay in order
+__attribute__((target("avx2"))) void blend_row_avx2(gfx::color* dst, gfx::color const* src, std::size_t n) noexcept
 {
-    impl::canvas_destroy(handle);
+    auto const zero = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        auto const d = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(dst + i));
+        auto const lo = blend_half_avx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+        auto const hi = blend_half_avx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    blend_row_scalar(dst + i, src + i, n - i);
 }
 
-canvas::canvas(window const& window, vsync vs) noexcept
-    : handle{impl::canvas_create(window.handle, vs)}
-{}
+__attribute__((target("avx2"))) void keyed_row_avx2(gfx::color* dst, gfx::color const* src, std::size_t n, gfx::color key) noexcept
+{
+    auto const mask = _mm256_set1_epi32(static_cast<int32_t>(rgb_mask));
+    auto const k = _mm256_set1_epi32(static_cast<int32_t>(std::bit_cast<uint32_t>(key) & rgb_mask));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+        auto const d = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(dst + i));
+        auto const keyed = _mm256_cmpeq_epi32(_mm256_and_si256(s, mask), k);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_blendv_epi8(s, d, keyed));
+    }
+    keyed_row_scalar(dst + i, src + i, n - i, key);
+}
 
-canvas& canvas::operator=(canvas&& rhs) noexcept
+#endif
+
+using blend_row_kernel = void (*)(gfx::color*, gfx::color const*, std::size_t) noexcept;
+
+using keyed_row_kernel = void (*)(gfx::color*, gfx::color const*, std::size_t, gfx::color) noexcept;
+
+blend_row_kernel blend_row_kernel_select() noexcept
 {
-    auto* temp = rhs.handle;
-    rhs.handle = nullptr;
-    impl::canvas_destroy(handle);
-    handle = temp;
-    return *this;
+#if defined(GFX_HAS_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return blend_row_avx2;
+    }
+#endif
+#if defined(GFX_HAS_SSE2)
+    return blend_row_sse2;
+#else
+    return blend_row_scalar;
+#endif
 }
 
-[[nodiscard]] color
-canvas::operator[](point const& p) const noexcept
+keyed_row_kernel keyed_row_kernel_select() noexcept
 {
-    return impl::canvas_color_pick(handle, p);
+#if defined(GFX_HAS_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return keyed_row_avx2;
+    }
+#endif
+#if defined(GFX_HAS_SSE2)
+    return keyed_row_sse2;
+#else
+    return keyed_row_scalar;
+#endif
 }
 
-[[nodiscard]] vector
-canvas::size() const noexcept
+blend_row_kernel const blend_row = blend_row_kernel_select();
+
+keyed_row_kernel const keyed_row = keyed_row_kernel_select();
+
+// Buffers the shape and gradient drawing functions build their input in. They are reused across calls and only grow,
+// so drawing does not allocate once they hold the largest shape drawn on this thread.
+struct shape_buffers
 {
-    return impl::canvas_size(handle);
+    std::vector<gfx::color> ramp{};
+    std::vector<gfx::color> c0{};
+    std::vector<gfx::color> c1{};
+    std::vector<float> fractions{};
+    std::vector<int32_t> rows{};
+    std::vector<gfx::rect> spans{};
+};
+
+thread_local shape_buffers shapes;
+
+// Fills the first n colors of shapes.ramp with the gradient colors at evenly spaced positions from offset 0 to offset 1
+std::span<gfx::color const> gradient_ramp(std::span<gfx::gradient_stop const> stops, std::size_t n)
+{
+    shapes.ramp.resize(n);
+    shapes.c0.resize(n);
+    shapes.c1.resize(n);
+    shapes.fractions.resize(n);
+    auto& ramp = shapes.ramp;
+    auto& c0 = shapes.c0;
+    auto& c1 = shapes.c1;
+    auto& fractions = shapes.fractions;
+    std::size_t stop = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        auto const t = n == 1 ? 0.f : float(i) / float(n - 1);
+        while (stop + 1 < stops.size() && stops[stop + 1].offset <= t) {
+            ++stop;
+        }
+        auto const& lo = stops[stop];
+        auto const& hi = stops[std::min(stop + 1, stops.size() - 1)];
+        c0[i] = hi.col;
+        c1[i] = lo.col;
+        fractions[i] = hi.offset > lo.offset ? std::clamp((t - lo.offset) / (hi.offset - lo.offset), 0.f, 1.f) : 0.f;
+    }
+    gfx::color_blend(c0, c1, fractions, ramp);
+
+    // Blending rounds down, so the stop colors themselves are copied to keep them exact
+    for (std::size_t i = 0; i < n; ++i) {
+        if (fractions[i] <= 0.f) {
+            ramp[i] = c1[i];
+        } else if (fractions[i] >= 1.f) {
+            ramp[i] = c0[i];
+        }
+    }
+    return ramp;
 }
 
-[[nodiscard]] point
-canvas::first() const noexcept
+// Half-widths of the rows of an ellipse, from the middle row outwards, followed by -1 for the row beyond the edge
+// Pixel centers within radii minus half a pixel are inside, so a radius of 1 covers a single pixel
+std::span<int32_t const> ellipse_half_widths(gfx::vector radii)
 {
-    return {0, 0};
+    auto const a = double(radii.x) - 0.5;
+    auto const b = double(radii.y) - 0.5;
+    auto const last = static_cast<int32_t>(b);
+    auto& rows = shapes.rows;
+    rows.assign(static_cast<std::size_t>(last) + 2, -1);
+    for (int32_t k = 0; k <= last; ++k) {
+        auto const t = double(k) / b;
+        rows[static_cast<std::size_t>(k)] = static_cast<int32_t>(a * std::sqrt(std::max(0.0, 1.0 - t * t)));
+    }
+    return rows;
 }
 
-[[nodiscard]] point
-canvas::last() const noexcept
+}
+
+namespace gfx {
+
+namespace v0 {
+
+color color_blend(color c0, color c1, float fraction) noexcept
 {
-    return point{-1, -1} + size();
+    return blend_color(c0, c1, fraction);
 }
 
-void render(canvas& can) noexcept
+void color_blend(std::span<color const> c0, std::span<color const> c1, std::span<float const> fractions, std::span<color> out) noexcept
 {
-    return impl::canvas_render(can.handle);
+    auto const n = std::min({c0.size(), c1.size(), fractions.size(), out.size()});
+    blend_batch(c0.data(), c1.data(), fractions.data(), out.data(), n);
 }
 
-void clear(canvas& can, color const& col) noexcept
+void pixels_fill(pixel_view const& dst, color const& col) noexcept
 {
-    impl::canvas_clear(can.handle, col);
+    if (dst.empty()) {
+        return;
+    }
+    auto const w = static_cast<std::size_t>(dst.size.x);
+    if (dst.stride == w) {
+        std::fill_n(dst.pixels.data(), w * static_cast<std::size_t>(dst.size.y), col);
+        return;
+    }
+    for (int32_t y = 0; y < dst.size.y; ++y) {
+        std::fill_n(dst.row(y).data(), w, col);
+    }
 }
 
-[[nodiscard]] color
-color_get(canvas& can) noexcept
+// The views may overlap, for example when scrolling a locked region, so rows are copied in the direction that reads
+// each source row before it is overwritten
+void pixels_copy(pixel_view const& dst, const_pixel_view const& src) noexcept
 {
-    return impl::canvas_color_get(can.handle);
+    auto const w = static_cast<std::size_t>(std::min(dst.size.x, src.size.x));
+    auto const h = std::min(dst.size.y, src.size.y);
+    if (w == 0 || h <= 0 || dst.size.x < 0 || src.size.x < 0) {
+        return;
+    }
+    auto const bytes = w * sizeof(color);
+    if (dst.pixels.data() <= src.pixels.data()) {
+        for (int32_t y = 0; y < h; ++y) {
+            std::memmove(dst.row(y).data(), src.row(y).data(), bytes);
+        }
+    } else {
+        for (auto y = h - 1; y >= 0; --y) {
+            std::memmove(dst.row(y).data(), src.row(y).data(), bytes);
+        }
+    }
 }
 
-void color_set(canvas& can, color const& col) noexcept
+void pixels_blend(pixel_view const& dst, const_pixel_view const& src) noexcept
 {
-    impl::canvas_color_set(can.handle, col);
+    auto const w = std::min(dst.size.x, src.size.x);
+    auto const h = std::min(dst.size.y, src.size.y);
+    for (int32_t y = 0; y < h && w > 0; ++y) {
+        blend_row(dst.row(y).data(), src.row(y).data(), static_cast<std::size_t>(w));
+    }
 }
 
-void draw_point(canvas& can, point const& p) noexcept
+void pixels_blit_keyed(pixel_view const& dst, const_pixel_view const& src, color const& key) noexcept
 {
-    impl::canvas_draw_point(can.handle, p);
+    auto const w = std::min(dst.size.x, src.size.x);
+    auto const h = std::min(dst.size.y, src.size.y);
+    for (int32_t y = 0; y < h && w > 0; ++y) {
+        keyed_row(dst.row(y).data(), src.row(y).data(), static_cast<std::size_t>(w), key);
+    }
 }
 
-void draw_point(canvas& can, point const& p, color const& col) noexcept
+window::~window()
 {
-    auto old_col{color_get(can)};
-    color_set(can, col);
-    draw_point(can, p);
-    color_set(can, old_col);
+    impl::window_destroy(handle);
 }
 
-void draw_line(canvas& can, point const& p0, point const& p1) noexcept
+window::window(point pos, vector size, std::string const& title, visibility vis) noexcept
+    : handle{impl::window_create(pos, size, title, vis)}
+{}
+
+window& window::operator=(window&& rhs) noexcept
 {
-    impl::canvas_draw_line(can.handle, p0, p1);
+    auto* temp = rhs.handle;
+    rhs.handle = nullptr;
+    impl::window_destroy(handle);
+    handle = temp;
+    return *this;
 }
 
-void draw_line(canvas& can, point const& p0, point const& p1, color const& col) noexcept
+void window::show() noexcept
 {
-    auto old{color_get(can)};
-    color_set(can, col);
-    draw_line(can, p0, p1);
-    color_set(can, old);
+    impl::window_show(handle);
 }
 
-void draw_circle(canvas& can, point const& center, int32_t radius, fill f) noexcept
+void window::hide() noexcept
 {
-    if (f == fill::off) {
-        auto const diameter = (radius * 2);
-
-        auto x = (radius - 1);
-        auto y = 0;
-        auto tx = 1;
-        auto ty = 1;
-        auto error = (tx - diameter);
-
-        while (x >= y) {
-            impl::canvas_draw_point(can.handle, {center.x - x, center.y - y});
-            impl::canvas_draw_point(can.handle, {center.x - x, center.y + y});
-            impl::canvas_draw_point(can.handle, {center.x - y, center.y - x});
-            impl::canvas_draw_point(can.handle, {center.x - y, center.y + x});
-            impl::canvas_draw_point(can.handle, {center.x + x, center.y - y});
-            impl::canvas_draw_point(can.handle, {center.x + x, center.y + y});
-            impl::canvas_draw_point(can.handle, {center.x + y, center.y - x});
-            impl::canvas_draw_point(can.handle, {center.x + y, center.y + x});
-
-            if (error <= 0) {
-                ++y;
-                error += ty;
-                ty += 2;
-            }
+    impl::window_hide(handle);
+}
 
-            if (error > 0) {
-                --x;
-                tx += 2;
-                error += (tx - diameter);
-            }
-        }
-    } else {
-        auto const diameter = (radius * 2);
-
-        auto x = (radius - 1);
-        auto y = 0;
-        auto tx = 1;
-        auto ty = 1;
-        auto error = (tx - diameter);
-
-        while (x >= y) {
-            impl::canvas_draw_line(can.handle, {center.x - x, center.y - y}, {center.x + x, center.y - y});
-            impl::canvas_draw_line(can.handle, {center.x - x, center.y + y}, {center.x + x, center.y + y});
-            impl::canvas_draw_line(can.handle, {center.x - y, center.y - x}, {center.x + y, center.y - x});
-            impl::canvas_draw_line(can.handle, {center.x - y, center.y + x}, {center.x + y, center.y + x});
-
-            if (error <= 0) {
-                ++y;
-                error += ty;
-                ty += 2;
-            }
+mapped_file::~mapped_file()
+{
+    impl::file_unmap(bytes_);
+}
 
-            if (error > 0) {
-                --x;
-                tx += 2;
-                error += (tx - diameter);
-            }
-        }
+mapped_file& mapped_file::operator=(mapped_file&& rhs) noexcept
+{
+    auto const temp = std::exchange(rhs.bytes_, {});
+    impl::file_unmap(bytes_);
+    bytes_ = temp;
+    return *this;
+}
+
+[[nodiscard]] std::optional<mapped_file>
+mapped_file::open(std::filesystem::path const& path) noexcept
+{
+    auto const bytes = impl::file_map(path);
+    if (!bytes) {
+        return {};
+    } else {
+        return mapped_file{*bytes};
     }
 }
 
-void draw_circle(canvas& can, point const& center, int32_t radius, color const& col, fill f) noexcept
+[[nodiscard]] std::span<std::byte const>
+mapped_file::bytes() const noexcept
 {
-    auto old{color_get(can)};
-    color_set(can, col);
-    draw_circle(can, center, radius, f);
-    color_set(can, old);
+    return bytes_;
 }
 
-void draw_rect(canvas& can, point const& p, vector const& v, fill f) noexcept
+texture::~texture()
 {
-    impl::canvas_draw_rect(can.handle, p, v, f);
+    impl::texture_destroy(handle);
 }
 
-void draw_rect(canvas& can, point const& p, vector const& v, color const& col, fill f) noexcept
+texture& texture::operator=(texture&& rhs) noexcept
 {
-    auto old{color_get(can)};
-    color_set(can, col);
-    draw_rect(can, p, v, f);
-    color_set(can, old);
+    auto* temp = rhs.handle;
+    rhs.handle = nullptr;
+    impl::texture_destroy(handle);
+    handle = temp;
+    return *this;
 }
 
-void draw_texture(canvas& can, texture const& tex) noexcept
+[[nodiscard]] vector texture::size() const noexcept
 {
-    impl::canvas_draw_texture(can.handle, tex.handle);
+    return impl::texture_size(handle);
 }
 
-void draw_texture(canvas& can, texture const& tex, point const& p) noexcept
+[[nodiscard]] std::optional<texture>
+texture::load(canvas& can, std::filesystem::path const& path) noexcept
 {
-    impl::canvas_draw_texture(can.handle, tex.handle, p);
+    void* tp = impl::texture_load(can.handle, path);
+    if (tp == nullptr) {
+        return {};
+    } else {
+        return texture{tp};
+    }
 }
 
-void draw_texture(canvas& can, texture const& tex, point const& p, vector const& s) noexcept
+[[nodiscard]] std::optional<texture>
+texture::load(canvas& can, std::span<std::byte const> bytes) noexcept
+{
+    void* tp = impl::texture_load(can.handle, bytes);
+    if (tp == nullptr) {
+        return {};
+    } else {
+        return texture{tp};
+    }
+}
+
+[[nodiscard]] std::optional<texture>
+texture::create_target(canvas& can, vector size) noexcept
 {
-    impl::canvas_draw_texture(can.handle, tex.handle, p, s);
+    if (can.handle == nullptr || size.x <= 0 || size.y <= 0) {
+        return {};
+    }
+    void* tp = impl::texture_create_target(can.handle, size);
+    if (tp == nullptr) {
+        return {};
+    } else {
+        return texture{tp};
+    }
 }
 
-void draw_texture(canvas& can, texture const& tex, point const& p, vector const& s, point const& tp, vector const& ts) noexcept
+std::optional<texture>
+texture::load_cached(canvas& can, std::filesystem::path const& path) noexcept
+{
+    void* tp = impl::texture_load_cached(can.handle, path);
+    if (tp == nullptr) {
+        return {};
+    } else {
+        return texture{tp};
+    }
+}
+
+async_texture
+texture::load_async(canvas& can, std::filesystem::path const& path) noexcept
 {
-    impl::canvas_draw_texture(can.handle, tex.handle, p, s, tp, ts);
+    async_texture at;
+    at.state_ = std::make_shared<async_texture::state>();
+    // The texture is dropped if the caller lets go of the handle before it is uploaded
+    impl::texture_load_async(can.handle, path, [weak = std::weak_ptr{at.state_}](void* tp) {
+        if (auto st = weak.lock()) {
+            st->tex = texture{tp};
+            st->status.store(tp == nullptr ? load_status::failed : load_status::ready, std::memory_order_release);
+        } else {
+            impl::texture_destroy(tp);
+        }
+    });
+    return at;
 }
 
-void draw_text(canvas& can, std::string const& text, font const& f, point const& p) noexcept
+std::vector<async_texture>
+texture::load_all(canvas& can, std::span<std::filesystem::path const> paths) noexcept
 {
-    impl::canvas_draw_text(can.handle, text, f.handle, p, color_get(can));
+    std::vector<async_texture> textures;
+    textures.reserve(paths.size());
+    for (auto const& path : paths) {
+        textures.push_back(load_async(can, path));
+    }
+    return textures;
 }
 
-void draw_text(canvas& can, std::string const& text, font const& f, point const& p, color const& col) noexcept
+load_status async_texture::status() const noexcept
 {
-    impl::canvas_draw_text(can.handle, text, f.handle, p, col);
+    return state_ ? state_->status.load(std::memory_order_acquire) : load_status::failed;
+}
+
+texture const& async_texture::get() const noexcept
+{
+    static texture const empty;
+    return state_ ? state_->tex : empty;
+}
+
+texture const& async_texture::get(texture const& placeholder) const noexcept
+{
+    return status() == load_status::ready ? state_->tex : placeholder;
+}
+
+atlas::~atlas()
+{
+    impl::atlas_destroy(handle);
+}
+
+atlas::atlas(canvas& can, vector page_size) noexcept
+    : handle{impl::atlas_create(can.handle, page_size)}
+{}
+
+atlas& atlas::operator=(atlas&& rhs) noexcept
+{
+    auto* temp = rhs.handle;
+    rhs.handle = nullptr;
+    impl::atlas_destroy(handle);
+    handle = temp;
+    return *this;
+}
+
+std::optional<sprite> atlas::add(std::filesystem::path const& path) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return impl::atlas_add(handle, path);
+}
+
+std::optional<sprite> atlas::add(std::span<std::byte const> bytes) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return impl::atlas_add(handle, bytes);
+}
+
+std::optional<sprite> atlas::add(std::span<color const> pixels, vector size) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return impl::atlas_add(handle, pixels, size);
+}
+
+std::size_t atlas::pages() const noexcept
+{
+    return handle == nullptr ? 0 : impl::atlas_pages(handle);
+}
+
+font::~font()
+{
+    impl::font_destroy(handle);
+}
+
+font& font::operator=(font&& rhs) noexcept
+{
+    auto* temp = rhs.handle;
+    rhs.handle = nullptr;
+    impl::font_destroy(handle);
+    handle = temp;
+    return *this;
+}
+
+[[nodiscard]] std::optional<font>
+font::load(std::filesystem::path const& path, int32_t size) noexcept
+{
+    void* lib = impl::font_library_default();
+    void* fp = lib == nullptr ? nullptr : impl::font_library_load(lib, path, size);
+    if (fp == nullptr) {
+        return {};
+    } else {
+        return font{fp};
+    }
+}
+
+[[nodiscard]] std::optional<font>
+font::load(std::span<std::byte const> bytes, int32_t size) noexcept
+{
+    void* fp = impl::font_create(bytes, size);
+    if (fp == nullptr) {
+        return {};
+    } else {
+        return font{fp};
+    }
+}
+
+[[nodiscard]] vector
+font::text_size(font& f, char const* text) noexcept
+{
+    return text_size(std::as_const(f), std::string_view{text});
+}
+
+[[nodiscard]] vector
+font::text_size(font& f, std::string const& text) noexcept
+{
+    return text_size(std::as_const(f), std::string_view{text});
+}
+
+[[nodiscard]] vector
+font::text_size(font const& f, std::string_view text) noexcept
+{
+    return f.handle == nullptr ? vector{} : impl::font_text_size(f.handle, text);
+}
+
+void font::text_size(font const& f, std::span<std::string_view const> texts, std::span<vector> out) noexcept
+{
+    if (f.handle != nullptr) {
+        impl::font_text_sizes(f.handle, texts, out);
+    }
+}
+
+[[nodiscard]] glyph_atlas_stats
+font::atlas_stats() const noexcept
+{
+    return impl::font_atlas_stats(handle);
+}
+
+font_library::~font_library()
+{
+    impl::font_library_destroy(handle);
+}
+
+font_library::font_library() noexcept
+    : handle{impl::font_library_create()}
+{}
+
+font_library& font_library::operator=(font_library&& rhs) noexcept
+{
+    auto* temp = rhs.handle;
+    rhs.handle = nullptr;
+    impl::font_library_destroy(handle);
+    handle = temp;
+    return *this;
+}
+
+[[nodiscard]] std::optional<font>
+font_library::load(std::filesystem::path const& path, int32_t size) noexcept
+{
+    void* fp = handle == nullptr ? nullptr : impl::font_library_load(handle, path, size);
+    if (fp == nullptr) {
+        return {};
+    } else {
+        return font{fp};
+    }
+}
+
+[[nodiscard]] font_library_stats
+font_library::stats() const noexcept
+{
+    return handle == nullptr ? font_library_stats{} : impl::font_library_stats_get(handle);
+}
+
+text::text(void* ch, void* fh, std::string const& str, color const& col) noexcept
+    : canvas_handle{ch}
+    , font_{impl::font_share(fh)}
+    , str_{str}
+    , col_{col}
+{
+    rebuild();
+}
+
+void text::rebuild() noexcept
+{
+    tex_ = gfx::texture{impl::text_texture_create(canvas_handle, str_, font_.handle, col_)};
+    size_ = tex_.size();
+}
+
+[[nodiscard]] std::optional<text>
+text::create(canvas& can, font const& f, std::string const& str, color const& col) noexcept
+{
+    if (can.handle == nullptr || f.handle == nullptr) {
+        return {};
+    }
+    text t{can.handle, f.handle, str, col};
+    if (t.tex_.handle == nullptr) {
+        return {};
+    } else {
+        return t;
+    }
+}
+
+[[nodiscard]] vector
+text::size() const noexcept
+{
+    return size_;
+}
+
+[[nodiscard]] std::string const&
+text::str() const noexcept
+{
+    return str_;
+}
+
+[[nodiscard]] color
+text::col() const noexcept
+{
+    return col_;
+}
+
+[[nodiscard]] texture const&
+text::tex() const noexcept
+{
+    return tex_;
+}
+
+void text::set(std::string const& str) noexcept
+{
+    if (str != str_) {
+        str_ = str;
+        rebuild();
+    }
+}
+
+void text::set(color const& col) noexcept
+{
+    if (col != col_) {
+        col_ = col;
+        rebuild();
+    }
+}
+
+namespace {
+
+// Beyond this many separate dirty rectangles, uploading their bounding box is cheaper than one upload per rectangle
+constexpr std::size_t dirty_rects_max = 8;
+
+}
+
+streaming_texture::streaming_texture(void* ch, void* th, vector size) noexcept
+    : canvas_handle_{ch}
+    , tex_{th}
+    , pixels_(static_cast<std::size_t>(size.x) * static_cast<std::size_t>(size.y))
+    , size_{size}
+{
+    invalidate_clipped({{}, size});
+}
+
+// Adds a dirty rectangle, merging it with the ones it overlaps or touches
+void streaming_texture::invalidate_clipped(rect r) noexcept
+{
+    if (auto const clipped = impl::rects_intersection(r, {{}, size_})) {
+        impl::rects_merge(dirty_, *clipped, dirty_rects_max);
+    }
+}
+
+[[nodiscard]] std::optional<streaming_texture>
+streaming_texture::create(canvas& can, vector size) noexcept
+{
+    if (can.handle == nullptr || size.x <= 0 || size.y <= 0) {
+        return {};
+    }
+    void* tp = impl::texture_create_streaming(can.handle, size);
+    if (tp == nullptr) {
+        return {};
+    } else {
+        return streaming_texture{can.handle, tp, size};
+    }
+}
+
+[[nodiscard]] vector
+streaming_texture::size() const noexcept
+{
+    return size_;
+}
+
+[[nodiscard]] std::span<color>
+streaming_texture::lock() noexcept
+{
+    return lock({{}, size_});
+}
+
+[[nodiscard]] std::span<color>
+streaming_texture::lock(rect const& r) noexcept
+{
+    invalidate_clipped(r);
+    return pixels_;
+}
+
+void streaming_texture::update(rect const& r, std::span<color const> pixels) noexcept
+{
+    auto const clipped = impl::rects_intersection(r, {{}, size_});
+    if (!clipped || pixels.size() < static_cast<std::size_t>(r.size.x) * static_cast<std::size_t>(r.size.y)) {
+        return;
+    }
+    auto const& c = *clipped;
+    for (auto y = c.pos.y; y < c.pos.y + c.size.y; ++y) {
+        auto const src = pixels.subspan(static_cast<std::size_t>((y - r.pos.y) * r.size.x + (c.pos.x - r.pos.x)), static_cast<std::size_t>(c.size.x));
+        std::copy(src.begin(), src.end(), pixels_.begin() + (y * size_.x + c.pos.x));
+    }
+    invalidate_clipped(c);
+}
+
+[[nodiscard]] std::span<rect const>
+streaming_texture::dirty() const noexcept
+{
+    return dirty_;
+}
+
+[[nodiscard]] texture const&
+streaming_texture::tex() noexcept
+{
+    for (auto const& d : dirty_) {
+        impl::texture_update(canvas_handle_, tex_.handle, d, pixels_.data() + (d.pos.y * size_.x + d.pos.x), size_.x);
+    }
+    dirty_.clear();
+    return tex_;
+}
+
+canvas::~canvas()
+{
+    impl::canvas_destroy(handle);
+}
+
+canvas::canvas(window const& window, vsync vs) noexcept
+    : handle{impl::canvas_create(window.handle, vs)}
+{}
+
+canvas::canvas(vector size) noexcept
+    : handle{impl::canvas_create_headless(size)}
+{}
+
+canvas& canvas::operator=(canvas&& rhs) noexcept
+{
+    auto* temp = rhs.handle;
+    rhs.handle = nullptr;
+    impl::canvas_destroy(handle);
+    handle = temp;
+    return *this;
+}
+
+[[nodiscard]] color
+canvas::operator[](point const& p) const noexcept
+{
+    return impl::canvas_color_pick(handle, p);
+}
+
+[[nodiscard]] bool
+canvas::read(rect const& r, std::span<color> out) const noexcept
+{
+    if (r.size.x <= 0 || r.size.y <= 0 || out.size() < static_cast<std::size_t>(r.size.x) * static_cast<std::size_t>(r.size.y)) {
+        return false;
+    }
+    return impl::canvas_read_pixels(handle, r, out);
+}
+
+[[nodiscard]] vector
+canvas::size() const noexcept
+{
+    return impl::canvas_size(handle);
+}
+
+[[nodiscard]] point
+canvas::first() const noexcept
+{
+    return {0, 0};
+}
+
+[[nodiscard]] point
+canvas::last() const noexcept
+{
+    return point{-1, -1} + size();
+}
+
+[[nodiscard]] std::span<color const>
+canvas::pixels() const noexcept
+{
+    return impl::canvas_pixels(handle);
+}
+
+[[nodiscard]] draw_state_stats
+canvas::state_stats() const noexcept
+{
+    return impl::canvas_state_stats(handle);
+}
+
+[[nodiscard]] frame_stats
+canvas::stats() const noexcept
+{
+    return impl::canvas_stats(handle);
+}
+
+[[nodiscard]] texture_cache_stats
+canvas::cache_stats() const noexcept
+{
+    return impl::canvas_cache_stats(handle);
+}
+
+[[nodiscard]] std::span<rect const>
+canvas::damage() const noexcept
+{
+    return impl::canvas_damage(handle);
+}
+
+[[nodiscard]] canvas_lock
+canvas::lock(rect const& r) noexcept
+{
+    return {handle, impl::canvas_lock(handle, r)};
+}
+
+canvas_lock::canvas_lock(void* ch, pixel_view const& view) noexcept
+    : canvas_handle_{ch}
+    , view_{view}
+{}
+
+// A lock that got an empty view holds nothing, and must not unlock a region locked by someone else
+canvas_lock::~canvas_lock()
+{
+    if (!view_.empty()) {
+        impl::canvas_unlock(canvas_handle_);
+    }
+}
+
+[[nodiscard]] pixel_view const&
+canvas_lock::view() const noexcept
+{
+    return view_;
+}
+
+target_guard::target_guard(canvas& can, texture& target) noexcept
+    : canvas_handle{can.handle}
+    , previous{impl::canvas_target_get(can.handle)}
+{
+    impl::canvas_target_set(canvas_handle, target.handle);
+}
+
+target_guard::~target_guard()
+{
+    impl::canvas_target_set(canvas_handle, previous);
+}
+
+readback::readback(std::size_t size)
+    : slots(std::max<std::size_t>(size, 1))
+{}
+
+bool readback::capture(canvas& can, rect const& r) noexcept
+{
+    auto const h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == slots.size()) {
+        return false;
+    }
+    auto& s = slots[h % slots.size()];
+    s.pixels.resize(static_cast<std::size_t>(std::max(r.size.x, 0)) * static_cast<std::size_t>(std::max(r.size.y, 0)));
+    if (!can.read(r, s.pixels)) {
+        return false;
+    }
+    s.area = r;
+    s.sequence = sequence++;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+[[nodiscard]] std::optional<readback::frame>
+readback::acquire() const noexcept
+{
+    auto const t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+        return {};
+    }
+    auto const& s = slots[t % slots.size()];
+    return frame{s.area, s.sequence, s.pixels};
+}
+
+void readback::release() noexcept
+{
+    auto const t = tail.load(std::memory_order_relaxed);
+    if (t != head.load(std::memory_order_acquire)) {
+        tail.store(t + 1, std::memory_order_release);
+    }
+}
+
+events::events(std::size_t size)
+    : slots{std::make_unique<slot[]>(std::bit_ceil(std::max<std::size_t>(size, 2)))}
+    , mask{std::bit_ceil(std::max<std::size_t>(size, 2)) - 1}
+{
+    for (std::size_t i = 0; i <= mask; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// Runs on the thread that created the window. Consecutive mouse motion events are merged into the last of them, with
+// their relative motion added up, so that a fast mouse does not fill the ring.
+std::size_t events::pump() noexcept
+{
+    std::optional<event> motion;
+    std::size_t n{};
+    event e;
+    while (impl::event_next(e)) {
+        received.fetch_add(1, std::memory_order_relaxed);
+        if (e.type == event_type::mouse_motion) {
+            if (motion) {
+                e.delta = e.delta + motion->delta;
+                e.coalesced = motion->coalesced + 1;
+                coalesced.fetch_add(1, std::memory_order_relaxed);
+            }
+            motion = e;
+            continue;
+        }
+        if (motion) {
+            n += push(*motion) ? 1u : 0u;
+            motion.reset();
+        }
+        n += push(e) ? 1u : 0u;
+    }
+    if (motion) {
+        n += push(*motion) ? 1u : 0u;
+    }
+    return n;
+}
+
+// Only one thread may push. The event is dropped if the ring is full, rather than waiting for the consumers.
+bool events::push(event const& e) noexcept
+{
+    auto& s = slots[head & mask];
+    if (s.sequence.load(std::memory_order_acquire) != head) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    s.ev = e;
+    s.sequence.store(head + 1, std::memory_order_release);
+    ++head;
+    queued.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Consumers claim a slot by advancing the read position, then hand the slot back to the producer one lap ahead
+[[nodiscard]] std::optional<event>
+events::poll() noexcept
+{
+    auto t = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        auto& s = slots[t & mask];
+        auto const seq = s.sequence.load(std::memory_order_acquire);
+        auto const diff = static_cast<std::ptrdiff_t>(seq - (t + 1));
+        if (diff < 0) {
+            return {};
+        }
+        if (diff > 0) {
+            t = tail.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+            auto const e = s.ev;
+            s.sequence.store(t + mask + 1, std::memory_order_release);
+            return e;
+        }
+    }
+}
+
+std::size_t events::poll(std::span<event> out) noexcept
+{
+    std::size_t n{};
+    while (n < out.size()) {
+        auto e = poll();
+        if (!e) {
+            break;
+        }
+        out[n++] = *e;
+    }
+    return n;
+}
+
+[[nodiscard]] event_stats
+events::stats() const noexcept
+{
+    return {received.load(std::memory_order_relaxed), queued.load(std::memory_order_relaxed), coalesced.load(std::memory_order_relaxed), dropped.load(std::memory_order_relaxed)};
+}
+
+void render(canvas& can) noexcept
+{
+    return impl::canvas_render(can.handle);
+}
+
+void render(canvas& can, command_queue& q) noexcept
+{
+    submit(can, q);
+    render(can);
+}
+
+frame_pacer::frame_pacer(double fps, pacing mode, pacer_clock clock) noexcept
+    : clock_{std::move(clock)}
+    , spin_{std::chrono::milliseconds{2}}
+    , mode_{mode}
+{
+    if (!clock_.now) {
+        clock_.now = [] { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()); };
+    }
+    // A clock with a sleep function of its own, such as a mock, also spins through it, so that a mock clock only has to
+    // advance when asked to sleep
+    if (!clock_.yield) {
+        if (clock_.sleep) {
+            clock_.yield = clock_.sleep;
+        } else {
+            clock_.yield = [](std::chrono::nanoseconds) { std::this_thread::yield(); };
+        }
+    }
+    if (!clock_.sleep) {
+        clock_.sleep = [](std::chrono::nanoseconds d) { std::this_thread::sleep_for(d); };
+    }
+    fps_set(fps);
+}
+
+double frame_pacer::fps() const noexcept
+{
+    return period_.count() > 0 ? 1e9 / static_cast<double>(period_.count()) : 0.0;
+}
+
+void frame_pacer::fps_set(double fps) noexcept
+{
+    period_ = std::chrono::nanoseconds{fps > 0.0 ? std::llround(1e9 / fps) : 0};
+}
+
+pacing frame_pacer::mode() const noexcept
+{
+    return mode_;
+}
+
+void frame_pacer::mode_set(pacing mode) noexcept
+{
+    mode_ = mode;
+}
+
+std::chrono::nanoseconds frame_pacer::spin() const noexcept
+{
+    return spin_;
+}
+
+void frame_pacer::spin_set(std::chrono::nanoseconds spin) noexcept
+{
+    spin_ = std::max(spin, std::chrono::nanoseconds{});
+}
+
+pacer_stats frame_pacer::stats() const noexcept
+{
+    return stats_;
+}
+
+void frame_pacer::reset() noexcept
+{
+    started_ = false;
+    work_ = {};
+    jitter_sum_ms_ = 0.0;
+    jitter_samples_ = 0;
+    stats_ = {};
+}
+
+// Sleeps until the spin margin before t, since sleeps can overshoot by about a scheduler tick, and then spins for the
+// rest, yielding through the clock with the time left
+void frame_pacer::wait_until(std::chrono::nanoseconds t) noexcept
+{
+    auto left = t - clock_.now();
+    if (left > spin_) {
+        clock_.sleep(left - spin_);
+    }
+    while ((left = t - clock_.now()) > std::chrono::nanoseconds{}) {
+        clock_.yield(left);
+    }
+}
+
+void frame_pacer::jitter_add(std::chrono::nanoseconds error) noexcept
+{
+    auto const ms = std::abs(std::chrono::duration<double, std::milli>(error).count());
+    jitter_sum_ms_ += ms;
+    ++jitter_samples_;
+    stats_.jitter_ms = jitter_sum_ms_ / static_cast<double>(jitter_samples_);
+    stats_.jitter_max_ms = std::max(stats_.jitter_max_ms, ms);
+}
+
+// Called after each present. For throughput, the next frame starts on the next deadline. For low latency, the next
+// deadline is when the next present should finish, and the frame starts as late as the work estimate allows so that
+// input is sampled close to it. The estimate follows increases at once and decreases over a few frames, so a single
+// slow frame does not add latency for long.
+void frame_pacer::frame_end() noexcept
+{
+    auto const now = clock_.now();
+    if (!started_) {
+        started_ = true;
+        deadline_ = now;
+    } else {
+        auto const sample = now - woke_;
+        work_ = sample > work_ ? sample : (work_ * 7 + sample) / 8;
+        stats_.work_ms = std::chrono::duration<double, std::milli>(work_).count();
+        if (mode_ == pacing::low_latency && period_.count() > 0) {
+            jitter_add(now - deadline_);
+        }
+    }
+    ++stats_.frames;
+
+    if (period_.count() <= 0) {
+        woke_ = now;
+        deadline_ = now;
+        return;
+    }
+
+    auto next = deadline_ + period_;
+    if (mode_ == pacing::throughput) {
+        if (next < now) {
+            stats_.missed += static_cast<uint64_t>((now - next) / period_) + 1;
+            next = now;
+        }
+        wait_until(next);
+        woke_ = clock_.now();
+        jitter_add(woke_ - next);
+    } else {
+        auto const lead = std::min(work_ + work_ / 4, period_);
+        while (next - lead < now) {
+            next += period_;
+            ++stats_.missed;
+        }
+        wait_until(next - lead);
+        woke_ = clock_.now();
+    }
+    deadline_ = next;
+}
+
+void render(canvas& can, frame_pacer& fp) noexcept
+{
+    render(can);
+    fp.frame_end();
+}
+
+void clear(canvas& can, color const& col) noexcept
+{
+    impl::canvas_clear(can.handle, col);
+}
+
+[[nodiscard]] color
+color_get(canvas& can) noexcept
+{
+    return impl::canvas_color_get(can.handle);
+}
+
+void color_set(canvas& can, color const& col) noexcept
+{
+    impl::canvas_color_set(can.handle, col);
+}
+
+[[nodiscard]] blend
+blend_get(canvas& can) noexcept
+{
+    return impl::canvas_blend_get(can.handle);
+}
+
+void blend_set(canvas& can, blend b) noexcept
+{
+    impl::canvas_blend_set(can.handle, b);
+}
+
+[[nodiscard]] std::optional<rect>
+clip_get(canvas& can) noexcept
+{
+    return impl::canvas_clip_get(can.handle);
+}
+
+void clip_set(canvas& can, rect const& r) noexcept
+{
+    impl::canvas_clip_set(can.handle, r);
+}
+
+void clip_reset(canvas& can) noexcept
+{
+    impl::canvas_clip_set(can.handle, {});
+}
+
+std::size_t cache_budget_get(canvas& can) noexcept
+{
+    return impl::canvas_cache_budget_get(can.handle);
+}
+
+void cache_budget_set(canvas& can, std::size_t bytes) noexcept
+{
+    impl::canvas_cache_budget_set(can.handle, bytes);
+}
+
+dedupe cache_dedupe_get(canvas& can) noexcept
+{
+    return impl::canvas_cache_dedupe_get(can.handle);
+}
+
+void cache_dedupe_set(canvas& can, dedupe d) noexcept
+{
+    impl::canvas_cache_dedupe_set(can.handle, d);
+}
+
+redraw redraw_get(canvas& can) noexcept
+{
+    return impl::canvas_redraw_get(can.handle);
+}
+
+void redraw_set(canvas& can, redraw r) noexcept
+{
+    impl::canvas_redraw_set(can.handle, r);
+}
+
+void invalidate(canvas& can, rect const& r) noexcept
+{
+    impl::canvas_invalidate(can.handle, r);
+}
+
+std::size_t upload_budget_get(canvas& can) noexcept
+{
+    return impl::canvas_upload_budget_get(can.handle);
+}
+
+void upload_budget_set(canvas& can, std::size_t bytes) noexcept
+{
+    impl::canvas_upload_budget_set(can.handle, bytes);
+}
+
+void draw_point(canvas& can, point const& p) noexcept
+{
+    draw_point(can, p, color_get(can));
+}
+
+void draw_point(canvas& can, point const& p, color const& col) noexcept
+{
+    impl::canvas_draw_point(can.handle, p, col);
+}
+
+void draw_points(canvas& can, std::span<point const> ps) noexcept
+{
+    draw_points(can, ps, color_get(can));
+}
+
+void draw_points(canvas& can, std::span<point const> ps, color const& col) noexcept
+{
+    if (!ps.empty()) {
+        impl::canvas_draw_points(can.handle, ps, col);
+    }
+}
+
+void draw_points(canvas& can, std::span<point const> ps, std::span<color const> cols) noexcept
+{
+    if (!ps.empty()) {
+        impl::canvas_draw_points(can.handle, ps, cols);
+    }
+}
+
+void draw_line(canvas& can, point const& p0, point const& p1) noexcept
+{
+    draw_line(can, p0, p1, color_get(can));
+}
+
+void draw_line(canvas& can, point const& p0, point const& p1, color const& col) noexcept
+{
+    impl::canvas_draw_line(can.handle, p0, p1, col);
+}
+
+void draw_lines(canvas& can, std::span<point const> ps) noexcept
+{
+    draw_lines(can, ps, color_get(can));
+}
+
+void draw_lines(canvas& can, std::span<point const> ps, color const& col) noexcept
+{
+    if (ps.size() >= 2) {
+        impl::canvas_draw_lines(can.handle, ps, col);
+    }
+}
+
+void draw_lines(canvas& can, std::span<point const> ps, std::span<color const> cols) noexcept
+{
+    if (ps.size() >= 2) {
+        impl::canvas_draw_lines(can.handle, ps, cols);
+    }
+}
+
+void draw_polyline(canvas& can, std::span<point const> ps) noexcept
+{
+    draw_polyline(can, ps, color_get(can));
+}
+
+void draw_polyline(canvas& can, std::span<point const> ps, color const& col) noexcept
+{
+    if (ps.size() >= 2) {
+        impl::canvas_draw_polyline(can.handle, ps, col);
+    }
+}
+
+void draw_polyline(canvas& can, std::span<point const> ps, std::span<color const> cols) noexcept
+{
+    if (ps.size() >= 2) {
+        impl::canvas_draw_polyline(can.handle, ps, cols);
+    }
+}
+
+void draw_circle(canvas& can, point const& center, int32_t radius, fill f) noexcept
+{
+    draw_circle(can, center, radius, color_get(can), f);
+}
+
+void draw_circle(canvas& can, point const& center, int32_t radius, color const& col, fill f) noexcept
+{
+    draw_ellipse(can, center, {radius, radius}, col, f);
+}
+
+void draw_ellipse(canvas& can, point const& center, vector const& radii, fill f) noexcept
+{
+    draw_ellipse(can, center, radii, color_get(can), f);
+}
+
+void draw_ellipse(canvas& can, point const& center, vector const& radii, color const& col, fill f) noexcept
+{
+    if (can.handle == nullptr || radii.x <= 0 || radii.y <= 0) {
+        return;
+    }
+
+    // Half-widths of the rows from the middle row outwards, plus a terminating -1 for the row beyond the edge
+    auto const rows = ellipse_half_widths(radii);
+
+    // Every pixel is covered by exactly one span, and all spans are submitted in a single call
+    auto& spans = shapes.spans;
+    spans.clear();
+    auto const emit = [&](int32_t y, int32_t x0, int32_t x1) {
+        spans.push_back({{center.x + x0, center.y + y}, {x1 - x0 + 1, 1}});
+    };
+    auto const last = static_cast<int32_t>(rows.size()) - 2;
+    for (int32_t dy = -last; dy <= last; ++dy) {
+        auto const k = static_cast<std::size_t>(dy < 0 ? -dy : dy);
+        auto const half = rows[k];
+        // An outline row covers the pixels not overlapped by the narrower row further out
+        auto const inner = (f == fill::on) ? 0 : std::min(rows[k + 1] + 1, half);
+        if (inner == 0) {
+            emit(dy, -half, half);
+        } else {
+            emit(dy, -half, -inner);
+            emit(dy, inner, half);
+        }
+    }
+    impl::canvas_draw_rects(can.handle, spans, col, fill::on);
+}
+
+void draw_rect(canvas& can, point const& p, vector const& v, fill f) noexcept
+{
+    draw_rect(can, p, v, color_get(can), f);
+}
+
+void draw_rect(canvas& can, point const& p, vector const& v, color const& col, fill f) noexcept
+{
+    impl::canvas_draw_rect(can.handle, p, v, col, f);
+}
+
+void draw_rects(canvas& can, std::span<rect const> rs, fill f) noexcept
+{
+    draw_rects(can, rs, color_get(can), f);
+}
+
+void draw_rects(canvas& can, std::span<rect const> rs, color const& col, fill f) noexcept
+{
+    if (!rs.empty()) {
+        impl::canvas_draw_rects(can.handle, rs, col, f);
+    }
+}
+
+void draw_rects(canvas& can, std::span<rect const> rs, std::span<color const> cols, fill f) noexcept
+{
+    if (!rs.empty()) {
+        impl::canvas_draw_rects(can.handle, rs, cols, f);
+    }
+}
+
+void draw_gradient_rect(canvas& can, point const& p, vector const& v, std::span<gradient_stop const> stops, float angle) noexcept
+{
+    if (can.handle == nullptr || stops.empty() || v.x <= 0 || v.y <= 0) {
+        return;
+    }
+
+    auto const radians = angle * std::numbers::pi_v<float> / 180.f;
+    auto const horizontal = std::abs(std::sin(radians)) < 1e-6f;
+    auto const vertical = std::abs(std::cos(radians)) < 1e-6f;
+    auto const dx = vertical ? 0.f : std::cos(radians);
+    auto const dy = horizontal ? 0.f : std::sin(radians);
+
+    // Axis-aligned gradients are generated as a single row or column and stretched over the rectangle
+    vector const size{vertical ? 1 : v.x, horizontal ? 1 : v.y};
+
+    // Position along the gradient is the projection of each pixel center on the gradient direction
+    auto const extent = std::abs(dx) * float(v.x) + std::abs(dy) * float(v.y);
+    auto const start = std::min(0.f, dx * float(v.x)) + std::min(0.f, dy * float(v.y));
+    auto const ramp = gradient_ramp(stops, std::max<std::size_t>(static_cast<std::size_t>(std::ceil(extent)), 1));
+
+    auto pixels = impl::canvas_scratch_pixels(can.handle, size);
+    auto const last = float(ramp.size() - 1);
+    auto const count = float(ramp.size());
+    for (int32_t y = 0; y < size.y; ++y) {
+        for (int32_t x = 0; x < size.x; ++x) {
+            auto const t = (dx * (float(x) + 0.5f) + dy * (float(y) + 0.5f) - start) / extent;
+            pixels[static_cast<std::size_t>(y * size.x + x)] = ramp[static_cast<std::size_t>(std::clamp(t * count, 0.f, last))];
+        }
+    }
+    impl::canvas_draw_scratch_pixels(can.handle, size, rect{p, v});
+}
+
+void draw_gradient_rect(canvas& can, point const& p, vector const& v, color const& c0, color const& c1, float angle) noexcept
+{
+    gradient_stop const stops[]{{0.f, c0}, {1.f, c1}};
+    draw_gradient_rect(can, p, v, stops, angle);
+}
+
+void draw_gradient_circle(canvas& can, point const& center, int32_t radius, std::span<gradient_stop const> stops) noexcept
+{
+    if (can.handle == nullptr || stops.empty() || radius < 0) {
+        return;
+    }
+
+    auto const ramp = gradient_ramp(stops, static_cast<std::size_t>(radius) + 1);
+
+    // Only the pixels inside the circle are generated and drawn, as one span per row
+    auto const diameter = 2 * radius + 1;
+    auto pixels = impl::canvas_scratch_pixels(can.handle, {diameter, diameter});
+    auto& spans = shapes.spans;
+    spans.clear();
+    for (int32_t dy = -radius; dy <= radius; ++dy) {
+        auto const half = static_cast<int32_t>(std::sqrt(float(radius * radius - dy * dy)));
+        auto const y = dy + radius;
+        for (int32_t dx = -half; dx <= half; ++dx) {
+            auto const d = std::sqrt(float(dx * dx + dy * dy));
+            pixels[static_cast<std::size_t>(y * diameter + dx + radius)] = ramp[std::min(static_cast<std::size_t>(d + 0.5f), ramp.size() - 1)];
+        }
+        spans.push_back({{radius - half, y}, {2 * half + 1, 1}});
+    }
+    impl::canvas_draw_scratch_pixels(can.handle, {diameter, diameter}, center - vector{radius, radius}, spans);
+}
+
+void draw_gradient_circle(canvas& can, point const& center, int32_t radius, color const& c0, color const& c1) noexcept
+{
+    gradient_stop const stops[]{{0.f, c0}, {1.f, c1}};
+    draw_gradient_circle(can, center, radius, stops);
+}
+
+void draw_texture(canvas& can, texture const& tex) noexcept
+{
+    if (tex.handle != nullptr) {
+        impl::canvas_draw_texture(can.handle, tex.handle);
+    }
+}
+
+void draw_texture(canvas& can, texture const& tex, point const& p) noexcept
+{
+    if (tex.handle != nullptr) {
+        impl::canvas_draw_texture(can.handle, tex.handle, p);
+    }
+}
+
+void draw_texture(canvas& can, texture const& tex, point const& p, vector const& s) noexcept
+{
+    if (tex.handle != nullptr) {
+        impl::canvas_draw_texture(can.handle, tex.handle, p, s);
+    }
+}
+
+void draw_texture(canvas& can, texture const& tex, point const& p, vector const& s, point const& tp, vector const& ts) noexcept
+{
+    if (tex.handle != nullptr) {
+        impl::canvas_draw_texture(can.handle, tex.handle, p, s, tp, ts);
+    }
+}
+
+void draw_text(canvas& can, std::string const& text, font const& f, point const& p) noexcept
+{
+    impl::canvas_draw_text(can.handle, text, f.handle, p, color_get(can));
+}
+
+void draw_text(canvas& can, std::string const& text, font const& f, point const& p, color const& col) noexcept
+{
+    impl::canvas_draw_text(can.handle, text, f.handle, p, col);
+}
+
+void draw_text(canvas& can, text const& t, point const& p) noexcept
+{
+    if (t.tex_.handle != nullptr) {
+        impl::canvas_draw_texture(can.handle, t.tex_.handle, p, t.size_);
+    }
+}
+
+void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p) noexcept
+{
+    if (a.handle != nullptr) {
+        impl::canvas_draw_sprites(can.handle, a.handle, {&s, 1}, {&p, 1}, {});
+    }
+}
+
+void draw_sprite(canvas& can, atlas const& a, sprite const& s, point const& p, vector const& size) noexcept
+{
+    if (a.handle != nullptr) {
+        impl::canvas_draw_sprites(can.handle, a.handle, {&s, 1}, {&p, 1}, {&size, 1});
+    }
+}
+
+void draw_sprites(canvas& can, atlas const& a, std::span<sprite const> ss, std::span<point const> ps) noexcept
+{
+    if (a.handle != nullptr) {
+        impl::canvas_draw_sprites(can.handle, a.handle, ss, ps, {});
+    }
+}
+
+void draw_stats(canvas& can, font const& f, point const& p) noexcept
+{
+    auto const s = can.stats();
+    auto const& dc = s.draw_calls;
+    char lines[4][96];
+    std::snprintf(lines[0], sizeof lines[0], "frame %.2f ms  p50 %.2f  p90 %.2f  p99 %.2f", s.frame_ms, s.frame_ms_p50, s.frame_ms_p90, s.frame_ms_p99);
+    std::snprintf(lines[1], sizeof lines[1], "render %.2f ms  present %.2f ms", s.render_ms, s.present_ms);
+    std::snprintf(lines[2], sizeof lines[2], "draws %llu  sdl %llu  state %llu/%llu", static_cast<unsigned long long>(dc.points + dc.lines + dc.rects + dc.images + dc.textures + dc.sprites + dc.texts), static_cast<unsigned long long>(s.sdl_calls), static_cast<unsigned long long>(s.state.changes), static_cast<unsigned long long>(s.state.elided));
+    std::snprintf(lines[3], sizeof lines[3], "uploads %llu (%zu kB)  glyphs %llu", static_cast<unsigned long long>(s.uploads), s.upload_bytes / 1024, static_cast<unsigned long long>(s.rasterizations));
+
+    int32_t width{};
+    auto const height = font::text_size(f, std::string_view{"Mg"}).y;
+    for (auto const* line : lines) {
+        width = std::max(width, font::text_size(f, std::string_view{line}).x);
+    }
+    auto const pad = height / 4;
+    auto const previous = blend_get(can);
+    blend_set(can, blend::alpha);
+    draw_rect(can, p, {width + pad * 2, height * 4 + pad * 2}, {0, 0, 0, 160}, fill::on);
+    blend_set(can, previous);
+    for (auto i = 0; i < 4; ++i) {
+        draw_text(can, lines[i], f, {p.x + pad, p.y + pad + height * i}, white);
+    }
+}
+
+// Commands are stored as an opcode byte followed by their arguments. Arrays are stored as a count followed by the
+// elements, aligned so that they can be replayed in place without copying.
+struct command_stream
+{
+    enum class op : uint8_t
+    {
+        clear,
+        color_set,
+        blend_set,
+        clip_set,
+        clip_reset,
+        point,
+        points,
+        line,
+        lines,
+        polyline,
+        ellipse,
+        rect,
+        rects,
+        gradient_rect,
+        gradient_circle,
+        texture,
+        texture_at,
+        texture_scaled,
+        texture_region,
+        text,
+        text_object,
+        sprite,
+        sprite_scaled,
+        sprites
+    };
+
+    // How a drawing command is colored: with the color current at replay time, one color, or one color per element
+    enum class paint : uint8_t
+    {
+        current,
+        single,
+        each
+    };
+
+    static void pad(command_buffer& cb, std::size_t alignment)
+    {
+        cb.data.resize((cb.data.size() + alignment - 1) & ~(alignment - 1));
+    }
+
+    template <typename T>
+    static void put(command_buffer& cb, T const& v)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        pad(cb, alignof(T));
+        auto const bytes = std::as_bytes(std::span{&v, 1});
+        cb.data.insert(cb.data.end(), bytes.begin(), bytes.end());
+    }
+
+    template <typename T>
+    static void put(command_buffer& cb, std::span<T const> vs)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put(cb, static_cast<uint32_t>(vs.size()));
+        pad(cb, alignof(T));
+        auto const bytes = std::as_bytes(vs);
+        cb.data.insert(cb.data.end(), bytes.begin(), bytes.end());
+    }
+
+    static void put(command_buffer& cb, std::string const& str)
+    {
+        put(cb, std::span{str.data(), str.size()});
+    }
+
+    static void begin(command_buffer& cb, op o)
+    {
+        put(cb, o);
+        ++cb.count;
+    }
+
+    static void put_paint(command_buffer& cb)
+    {
+        put(cb, paint::current);
+    }
+
+    static void put_paint(command_buffer& cb, color const& col)
+    {
+        put(cb, paint::single);
+        put(cb, col);
+    }
+
+    static void put_paint(command_buffer& cb, std::span<color const> cols)
+    {
+        put(cb, paint::each);
+        put(cb, cols);
+    }
+
+    class reader
+    {
+        std::span<std::byte const> data;
+        std::size_t pos{};
+
+        void pad(std::size_t alignment) noexcept
+        {
+            pos = (pos + alignment - 1) & ~(alignment - 1);
+        }
+
+    public:
+        explicit reader(command_buffer const& cb) noexcept : data{cb.data} {}
+
+        [[nodiscard]] bool done() const noexcept
+        {
+            return pos >= data.size();
+        }
+
+        template <typename T>
+        [[nodiscard]] T get() noexcept
+        {
+            pad(alignof(T));
+            T v;
+            std::memcpy(&v, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return v;
+        }
+
+        template <typename T>
+        [[nodiscard]] std::span<T const> get_span() noexcept
+        {
+            auto const n = get<uint32_t>();
+            pad(alignof(T));
+            auto const first = reinterpret_cast<T const*>(data.data() + pos);
+            pos += n * sizeof(T);
+            return {first, n};
+        }
+    };
+
+    // Replays a drawing command that has overloads for the current color, one color and one color per element
+    template <typename Draw>
+    static void paint_with(canvas& can, reader& r, Draw draw) noexcept
+    {
+        switch (r.get<paint>()) {
+        case paint::current:
+            draw(color_get(can));
+            break;
+        case paint::single:
+            draw(r.get<color>());
+            break;
+        case paint::each:
+            draw(r.get_span<color>());
+            break;
+        }
+    }
+
+    // Reads the color of a drawing command that has no overload with one color per element
+    static color solid(canvas& can, reader& r) noexcept
+    {
+        return r.get<paint>() == paint::single ? r.get<color>() : color_get(can);
+    }
+
+    static void replay(canvas& can, command_buffer const& cb) noexcept
+    {
+        reader r{cb};
+        while (!r.done()) {
+            switch (r.get<op>()) {
+            case op::clear:
+                clear(can, r.get<color>());
+                break;
+            case op::color_set:
+                color_set(can, r.get<color>());
+                break;
+            case op::blend_set:
+                blend_set(can, r.get<blend>());
+                break;
+            case op::clip_set:
+                clip_set(can, r.get<gfx::rect>());
+                break;
+            case op::clip_reset:
+                clip_reset(can);
+                break;
+            case op::point: {
+                auto const p = r.get<gfx::point>();
+                draw_point(can, p, solid(can, r));
+                break;
+            }
+            case op::points: {
+                auto const ps = r.get_span<gfx::point>();
+                paint_with(can, r, [&](auto const& col) { draw_points(can, ps, col); });
+                break;
+            }
+            case op::line: {
+                auto const p0 = r.get<gfx::point>();
+                auto const p1 = r.get<gfx::point>();
+                draw_line(can, p0, p1, solid(can, r));
+                break;
+            }
+            case op::lines: {
+                auto const ps = r.get_span<gfx::point>();
+                paint_with(can, r, [&](auto const& col) { draw_lines(can, ps, col); });
+                break;
+            }
+            case op::polyline: {
+                auto const ps = r.get_span<gfx::point>();
+                paint_with(can, r, [&](auto const& col) { draw_polyline(can, ps, col); });
+                break;
+            }
+            case op::ellipse: {
+                auto const center = r.get<gfx::point>();
+                auto const radii = r.get<vector>();
+                auto const f = r.get<fill>();
+                draw_ellipse(can, center, radii, solid(can, r), f);
+                break;
+            }
+            case op::rect: {
+                auto const p = r.get<gfx::point>();
+                auto const v = r.get<vector>();
+                auto const f = r.get<fill>();
+                draw_rect(can, p, v, solid(can, r), f);
+                break;
+            }
+            case op::rects: {
+                auto const rs = r.get_span<gfx::rect>();
+                auto const f = r.get<fill>();
+                paint_with(can, r, [&](auto const& col) { draw_rects(can, rs, col, f); });
+                break;
+            }
+            case op::gradient_rect: {
+                auto const p = r.get<gfx::point>();
+                auto const v = r.get<vector>();
+                auto const angle = r.get<float>();
+                draw_gradient_rect(can, p, v, r.get_span<gradient_stop>(), angle);
+                break;
+            }
+            case op::gradient_circle: {
+                auto const center = r.get<gfx::point>();
+                auto const radius = r.get<int32_t>();
+                draw_gradient_circle(can, center, radius, r.get_span<gradient_stop>());
+                break;
+            }
+            case op::texture:
+                draw_texture(can, *r.get<gfx::texture const*>());
+                break;
+            case op::texture_at: {
+                auto const tex = r.get<gfx::texture const*>();
+                draw_texture(can, *tex, r.get<gfx::point>());
+                break;
+            }
+            case op::texture_scaled: {
+                auto const tex = r.get<gfx::texture const*>();
+                auto const p = r.get<gfx::point>();
+                draw_texture(can, *tex, p, r.get<vector>());
+                break;
+            }
+            case op::texture_region: {
+                auto const tex = r.get<gfx::texture const*>();
+                auto const p = r.get<gfx::point>();
+                auto const s = r.get<vector>();
+                auto const tp = r.get<gfx::point>();
+                draw_texture(can, *tex, p, s, tp, r.get<vector>());
+                break;
+            }
+            case op::text: {
+                auto const chars = r.get_span<char>();
+                auto const f = r.get<font const*>();
+                auto const p = r.get<gfx::point>();
+                draw_text(can, std::string{chars.begin(), chars.end()}, *f, p, solid(can, r));
+                break;
+            }
+            case op::text_object: {
+                auto const t = r.get<gfx::text const*>();
+                draw_text(can, *t, r.get<gfx::point>());
+                break;
+            }
+            case op::sprite: {
+                auto const a = r.get<atlas const*>();
+                auto const sp = r.get<gfx::sprite>();
+                draw_sprite(can, *a, sp, r.get<gfx::point>());
+                break;
+            }
+            case op::sprite_scaled: {
+                auto const a = r.get<atlas const*>();
+                auto const sp = r.get<gfx::sprite>();
+                auto const p = r.get<gfx::point>();
+                draw_sprite(can, *a, sp, p, r.get<vector>());
+                break;
+            }
+            case op::sprites: {
+                auto const a = r.get<atlas const*>();
+                auto const ss = r.get_span<gfx::sprite>();
+                draw_sprites(can, *a, ss, r.get_span<gfx::point>());
+                break;
+            }
+            }
+        }
+    }
+};
+
+command_buffer::command_buffer(std::size_t bytes)
+{
+    data.reserve(bytes);
+}
+
+std::size_t command_buffer::size() const noexcept
+{
+    return count;
+}
+
+std::size_t command_buffer::bytes() const noexcept
+{
+    return data.size();
+}
+
+bool command_buffer::empty() const noexcept
+{
+    return count == 0;
+}
+
+void command_buffer::reset() noexcept
+{
+    data.clear();
+    count = 0;
+}
+
+void submit(canvas& can, command_buffer const& cb) noexcept
+{
+    command_stream::replay(can, cb);
+}
+
+command_queue::command_queue(std::size_t threads, std::size_t bytes)
+    : lanes(threads)
+{
+    for (auto& l : lanes) {
+        l.buffer = command_buffer{bytes};
+    }
+}
+
+std::size_t command_queue::size() const noexcept
+{
+    return lanes.size();
+}
+
+command_buffer& command_queue::operator[](std::size_t thread) noexcept
+{
+    return lanes[thread].buffer;
+}
+
+command_buffer const& command_queue::operator[](std::size_t thread) const noexcept
+{
+    return lanes[thread].buffer;
+}
+
+// Lanes are replayed in index order regardless of which thread finished recording first, so the result is the same on
+// every run
+void submit(canvas& can, command_queue& q) noexcept
+{
+    for (std::size_t i = 0; i < q.size(); ++i) {
+        submit(can, q[i]);
+        q[i].reset();
+    }
+}
+
+void clear(command_buffer& cb, color const& col) noexcept
+{
+    command_stream::begin(cb, command_stream::op::clear);
+    command_stream::put(cb, col);
+}
+
+void color_set(command_buffer& cb, color const& col) noexcept
+{
+    command_stream::begin(cb, command_stream::op::color_set);
+    command_stream::put(cb, col);
+}
+
+void blend_set(command_buffer& cb, blend b) noexcept
+{
+    command_stream::begin(cb, command_stream::op::blend_set);
+    command_stream::put(cb, b);
+}
+
+void clip_set(command_buffer& cb, rect const& r) noexcept
+{
+    command_stream::begin(cb, command_stream::op::clip_set);
+    command_stream::put(cb, r);
+}
+
+void clip_reset(command_buffer& cb) noexcept
+{
+    command_stream::begin(cb, command_stream::op::clip_reset);
+}
+
+void draw_point(command_buffer& cb, point const& p) noexcept
+{
+    command_stream::begin(cb, command_stream::op::point);
+    command_stream::put(cb, p);
+    command_stream::put_paint(cb);
+}
+
+void draw_point(command_buffer& cb, point const& p, color const& c) noexcept
+{
+    command_stream::begin(cb, command_stream::op::point);
+    command_stream::put(cb, p);
+    command_stream::put_paint(cb, c);
+}
+
+void draw_points(command_buffer& cb, std::span<point const> ps) noexcept
+{
+    command_stream::begin(cb, command_stream::op::points);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb);
+}
+
+void draw_points(command_buffer& cb, std::span<point const> ps, color const& col) noexcept
+{
+    command_stream::begin(cb, command_stream::op::points);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_points(command_buffer& cb, std::span<point const> ps, std::span<color const> cols) noexcept
+{
+    command_stream::begin(cb, command_stream::op::points);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb, cols);
+}
+
+void draw_line(command_buffer& cb, point const& p0, point const& p1) noexcept
+{
+    command_stream::begin(cb, command_stream::op::line);
+    command_stream::put(cb, p0);
+    command_stream::put(cb, p1);
+    command_stream::put_paint(cb);
+}
+
+void draw_line(command_buffer& cb, point const& p0, point const& p1, color const& col) noexcept
+{
+    command_stream::begin(cb, command_stream::op::line);
+    command_stream::put(cb, p0);
+    command_stream::put(cb, p1);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_lines(command_buffer& cb, std::span<point const> ps) noexcept
+{
+    command_stream::begin(cb, command_stream::op::lines);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb);
+}
+
+void draw_lines(command_buffer& cb, std::span<point const> ps, color const& col) noexcept
+{
+    command_stream::begin(cb, command_stream::op::lines);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_lines(command_buffer& cb, std::span<point const> ps, std::span<color const> cols) noexcept
+{
+    command_stream::begin(cb, command_stream::op::lines);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb, cols);
+}
+
+void draw_polyline(command_buffer& cb, std::span<point const> ps) noexcept
+{
+    command_stream::begin(cb, command_stream::op::polyline);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb);
+}
+
+void draw_polyline(command_buffer& cb, std::span<point const> ps, color const& col) noexcept
+{
+    command_stream::begin(cb, command_stream::op::polyline);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_polyline(command_buffer& cb, std::span<point const> ps, std::span<color const> cols) noexcept
+{
+    command_stream::begin(cb, command_stream::op::polyline);
+    command_stream::put(cb, ps);
+    command_stream::put_paint(cb, cols);
+}
+
+void draw_circle(command_buffer& cb, point const& center, int32_t radius, fill f) noexcept
+{
+    draw_ellipse(cb, center, {radius, radius}, f);
+}
+
+void draw_circle(command_buffer& cb, point const& center, int32_t radius, color const& col, fill f) noexcept
+{
+    draw_ellipse(cb, center, {radius, radius}, col, f);
+}
+
+void draw_ellipse(command_buffer& cb, point const& center, vector const& radii, fill f) noexcept
+{
+    command_stream::begin(cb, command_stream::op::ellipse);
+    command_stream::put(cb, center);
+    command_stream::put(cb, radii);
+    command_stream::put(cb, f);
+    command_stream::put_paint(cb);
+}
+
+void draw_ellipse(command_buffer& cb, point const& center, vector const& radii, color const& col, fill f) noexcept
+{
+    command_stream::begin(cb, command_stream::op::ellipse);
+    command_stream::put(cb, center);
+    command_stream::put(cb, radii);
+    command_stream::put(cb, f);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_rect(command_buffer& cb, point const& p, vector const& v, fill f) noexcept
+{
+    command_stream::begin(cb, command_stream::op::rect);
+    command_stream::put(cb, p);
+    command_stream::put(cb, v);
+    command_stream::put(cb, f);
+    command_stream::put_paint(cb);
+}
+
+void draw_rect(command_buffer& cb, point const& p, vector const& v, color const& col, fill f) noexcept
+{
+    command_stream::begin(cb, command_stream::op::rect);
+    command_stream::put(cb, p);
+    command_stream::put(cb, v);
+    command_stream::put(cb, f);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_rects(command_buffer& cb, std::span<rect const> rs, fill f) noexcept
+{
+    command_stream::begin(cb, command_stream::op::rects);
+    command_stream::put(cb, rs);
+    command_stream::put(cb, f);
+    command_stream::put_paint(cb);
+}
+
+void draw_rects(command_buffer& cb, std::span<rect const> rs, color const& col, fill f) noexcept
+{
+    command_stream::begin(cb, command_stream::op::rects);
+    command_stream::put(cb, rs);
+    command_stream::put(cb, f);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_rects(command_buffer& cb, std::span<rect const> rs, std::span<color const> cols, fill f) noexcept
+{
+    command_stream::begin(cb, command_stream::op::rects);
+    command_stream::put(cb, rs);
+    command_stream::put(cb, f);
+    command_stream::put_paint(cb, cols);
+}
+
+void draw_gradient_rect(command_buffer& cb, point const& p, vector const& v, std::span<gradient_stop const> stops, float angle) noexcept
+{
+    command_stream::begin(cb, command_stream::op::gradient_rect);
+    command_stream::put(cb, p);
+    command_stream::put(cb, v);
+    command_stream::put(cb, angle);
+    command_stream::put(cb, stops);
+}
+
+void draw_gradient_rect(command_buffer& cb, point const& p, vector const& v, color const& c0, color const& c1, float angle) noexcept
+{
+    gradient_stop const stops[]{{0.f, c0}, {1.f, c1}};
+    draw_gradient_rect(cb, p, v, stops, angle);
+}
+
+void draw_gradient_circle(command_buffer& cb, point const& center, int32_t radius, std::span<gradient_stop const> stops) noexcept
+{
+    command_stream::begin(cb, command_stream::op::gradient_circle);
+    command_stream::put(cb, center);
+    command_stream::put(cb, radius);
+    command_stream::put(cb, stops);
+}
+
+void draw_gradient_circle(command_buffer& cb, point const& center, int32_t radius, color const& c0, color const& c1) noexcept
+{
+    gradient_stop const stops[]{{0.f, c0}, {1.f, c1}};
+    draw_gradient_circle(cb, center, radius, stops);
+}
+
+void draw_texture(command_buffer& cb, texture const& tex) noexcept
+{
+    command_stream::begin(cb, command_stream::op::texture);
+    command_stream::put(cb, &tex);
+}
+
+void draw_texture(command_buffer& cb, texture const& tex, point const& p) noexcept
+{
+    command_stream::begin(cb, command_stream::op::texture_at);
+    command_stream::put(cb, &tex);
+    command_stream::put(cb, p);
+}
+
+void draw_texture(command_buffer& cb, texture const& tex, point const& p, vector const& s) noexcept
+{
+    command_stream::begin(cb, command_stream::op::texture_scaled);
+    command_stream::put(cb, &tex);
+    command_stream::put(cb, p);
+    command_stream::put(cb, s);
+}
+
+void draw_texture(command_buffer& cb, texture const& tex, point const& p, vector const& s, point const& tp, vector const& ts) noexcept
+{
+    command_stream::begin(cb, command_stream::op::texture_region);
+    command_stream::put(cb, &tex);
+    command_stream::put(cb, p);
+    command_stream::put(cb, s);
+    command_stream::put(cb, tp);
+    command_stream::put(cb, ts);
+}
+
+void draw_text(command_buffer& cb, std::string const& text, font const& f, point const& p) noexcept
+{
+    command_stream::begin(cb, command_stream::op::text);
+    command_stream::put(cb, text);
+    command_stream::put(cb, &f);
+    command_stream::put(cb, p);
+    command_stream::put_paint(cb);
+}
+
+void draw_text(command_buffer& cb, std::string const& text, font const& f, point const& p, color const& col) noexcept
+{
+    command_stream::begin(cb, command_stream::op::text);
+    command_stream::put(cb, text);
+    command_stream::put(cb, &f);
+    command_stream::put(cb, p);
+    command_stream::put_paint(cb, col);
+}
+
+void draw_text(command_buffer& cb, text const& t, point const& p) noexcept
+{
+    command_stream::begin(cb, command_stream::op::text_object);
+    command_stream::put(cb, &t);
+    command_stream::put(cb, p);
+}
+
+void draw_sprite(command_buffer& cb, atlas const& a, sprite const& s, point const& p) noexcept
+{
+    command_stream::begin(cb, command_stream::op::sprite);
+    command_stream::put(cb, &a);
+    command_stream::put(cb, s);
+    command_stream::put(cb, p);
+}
+
+void draw_sprite(command_buffer& cb, atlas const& a, sprite const& s, point const& p, vector const& size) noexcept
+{
+    command_stream::begin(cb, command_stream::op::sprite_scaled);
+    command_stream::put(cb, &a);
+    command_stream::put(cb, s);
+    command_stream::put(cb, p);
+    command_stream::put(cb, size);
+}
+
+void draw_sprites(command_buffer& cb, atlas const& a, std::span<sprite const> ss, std::span<point const> ps) noexcept
+{
+    command_stream::begin(cb, command_stream::op::sprites);
+    command_stream::put(cb, &a);
+    command_stream::put(cb, ss);
+    command_stream::put(cb, ps);
 }
 
 }
@@ -13,181 +13,2193 @@ It is also recommended that you include a file called COPYING (or COPYING.txt) c
 */
 #include "gfx_impl.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdlib>
+#include <deque>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "gfx.h"
 
-namespace gfx {
+namespace gfx {
+
+namespace v0 {
+
+namespace impl {
+
+namespace {
+
+struct canvas_context;
+
+enum class glyph_mode : uint32_t
+{
+    solid
+};
+
+struct glyph
+{
+    ::SDL_Rect src{};
+    int32_t offset{};
+    int32_t advance{};
+};
+
+struct glyph_atlas
+{
+    canvas_context* owner{};
+    ::SDL_Texture* texture{};
+    int32_t side{};
+
+    // Shelf packer state
+    int32_t shelf_x{};
+    int32_t shelf_y{};
+    int32_t shelf_h{};
+
+    std::unordered_map<uint64_t, glyph> glyphs{};
+
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t evictions{};
+};
+
+struct glyph_metrics
+{
+    int32_t minx{};
+    int32_t maxx{};
+    int32_t advance{};
+    bool known{};
+};
+
+struct font_library_context;
+
+struct font_face;
+
+// An open font size. Fonts loaded through a font library are shared by every font object loading the same file and
+// size, and read glyphs from the file contents kept by the library.
+struct font_context
+{
+    ::TTF_Font* font{};
+    glyph_atlas atlas{};
+    uint32_t refs{1};
+    font_library_context* library{};
+    font_face* face{};
+    int32_t size{};
+
+    // Glyph metrics and kerning read from the font once, so that text is measured without going through FreeType
+    std::array<glyph_metrics, 128> ascii_metrics{};
+    std::unordered_map<uint32_t, glyph_metrics> metrics{};
+    std::unordered_map<uint64_t, int32_t> kerning{};
+};
+
+struct font_face
+{
+    std::vector<char> bytes{};
+    std::unordered_map<int32_t, font_context*> sizes{};
+};
+
+// Kept alive by its owner and by each font it has open, so that the file contents outlive the fonts reading them
+struct font_library_context
+{
+    uint32_t refs{1};
+    std::unordered_map<std::string, font_face> faces{};
+};
+
+// A segment of the skyline of an atlas page: the top of the packed images from x to x + w is at y
+struct skyline_node
+{
+    int32_t x{};
+    int32_t y{};
+    int32_t w{};
+};
+
+struct atlas_page
+{
+    ::SDL_Texture* texture{};
+    std::vector<skyline_node> skyline{};
+};
+
+struct atlas_context
+{
+    canvas_context* canvas{};
+    vector page_size{};
+    std::vector<atlas_page> pages{};
+};
+
+struct texture_cache;
+
+// A texture shared through the texture cache of a canvas. Its SDL texture points back to it through the texture user
+// data, so that drawing it and destroying a reference to it can update the cache.
+struct cached_texture
+{
+    ::SDL_Texture* texture{};
+    std::vector<std::string> paths{};
+    std::optional<uint64_t> hash{};
+    std::size_t bytes{};
+    uint32_t refs{};
+    bool resident{};
+    std::list<cached_texture*>::iterator lru{};
+    texture_cache* cache{};
+};
+
+struct texture_cache
+{
+    std::unordered_map<std::string, cached_texture*> paths{};
+    std::unordered_map<uint64_t, cached_texture*> contents{};
+
+    // Resident entries, least recently drawn or loaded first
+    std::list<cached_texture*> lru{};
+
+    std::size_t budget{std::size_t{256} << 20};
+    dedupe mode{dedupe::path};
+    texture_cache_stats stats{};
+};
+
+// An image decoded by a loader thread, waiting to be uploaded on the render thread
+struct texture_upload
+{
+    ::SDL_Surface* surface{};
+    std::function<void(void*)> done{};
+};
+
+struct texture_job
+{
+    std::filesystem::path path{};
+    std::function<void(void*)> done{};
+};
+
+// Worker threads decoding image files for asynchronous texture loading
+struct texture_loader
+{
+    std::mutex mutex{};
+    std::condition_variable wake{};
+    std::deque<texture_job> jobs{};
+    std::vector<texture_upload> decoded{};
+    bool stop{};
+    std::vector<std::thread> workers{};
+};
+
+// Number of frames that frame time percentiles are computed over
+constexpr std::size_t frame_times_max = 128;
+
+// Beyond this many separate damaged regions, copying their bounding box is cheaper than one copy per region
+constexpr std::size_t damage_rects_max = 8;
+
+struct canvas_context
+{
+    ::SDL_Renderer* renderer{};
+
+    // CPU framebuffer of a headless canvas, owned by the context
+    ::SDL_Surface* surface{};
+
+    // Shadow copy of the draw state, to skip SDL calls that would not change anything
+    color col{};
+    color sdl_col{};
+    blend mode{};
+    std::optional<rect> clip{};
+
+    // Texture being drawn into, or null for the window, and the window clip rectangle to restore when drawing into the
+    // window again
+    ::SDL_Texture* target{};
+    std::optional<rect> window_clip{};
+
+    // Partial redraw: the frame is kept in a texture between renders, and the regions drawn into it are collected. While
+    // a region is invalidated, drawing is clipped to it instead. The backbuffer of the software renderer is kept between
+    // renders, so only the damaged regions need to be copied to it.
+    redraw redraw_mode{redraw::full};
+    ::SDL_Texture* frame{};
+    vector frame_size{};
+    bool backbuffer_kept{};
+    std::vector<rect> damage{};
+    std::vector<rect> last_damage{};
+    std::optional<rect> invalidated{};
+
+    // Counters of the frame being drawn and of the last rendered frame, and the times between the last renders
+    frame_stats stats{};
+    frame_stats last_stats{};
+    std::array<float, frame_times_max> frame_times{};
+    std::size_t frames{};
+    std::chrono::steady_clock::time_point last_render{};
+
+    // Fonts with a glyph atlas texture owned by this renderer
+    std::vector<font_context*> atlas_fonts{};
+
+    // Streaming texture and pixel buffer for generated images, grown as needed
+    ::SDL_Texture* scratch{};
+    vector scratch_size{};
+    std::vector<color> pixels{};
+
+    // Region locked with canvas::lock, and whether it is locked in place in the framebuffer of a headless canvas or
+    // read back into locked_pixels
+    std::optional<rect> locked{};
+    bool locked_in_place{};
+    std::vector<color> locked_pixels{};
+
+    texture_cache cache{};
+
+    // Asynchronous texture loading, started on first use, and decoded images not yet uploaded
+    std::unique_ptr<texture_loader> loader{};
+    std::deque<texture_upload> uploads{};
+    std::size_t upload_budget{std::size_t{8} << 20};
+
+    // Scratch buffers for batched submission, reused between calls to avoid allocations
+    std::vector<::SDL_Point> points{};
+    std::vector<::SDL_Rect> rects{};
+    std::vector<::SDL_Vertex> vertices{};
+    std::vector<int> indices{};
+};
+
+canvas_context& context(void* handle) noexcept
+{
+    return *reinterpret_cast<canvas_context*>(handle);
+}
+
+::SDL_Renderer* renderer(void* handle) noexcept
+{
+    return context(handle).renderer;
+}
+
+// Makes sure the renderer draw color is col without touching the drawing color seen by the user
+void color_apply(canvas_context& ctx, color const& col) noexcept
+{
+    if (col == ctx.sdl_col) {
+        ++ctx.stats.state.elided;
+    } else {
+        ::SDL_SetRenderDrawColor(ctx.renderer, col.r, col.g, col.b, col.a);
+        ctx.sdl_col = col;
+        ++ctx.stats.state.changes;
+        ++ctx.stats.sdl_calls;
+    }
+}
+
+// Counts a draw call of the given kind that was submitted with the given number of SDL calls
+void draw_count(canvas_context& ctx, uint64_t& kind, uint64_t sdl_calls) noexcept
+{
+    ++kind;
+    ctx.stats.sdl_calls += sdl_calls;
+}
+
+void upload_count(canvas_context& ctx, std::size_t bytes) noexcept
+{
+    ++ctx.stats.uploads;
+    ctx.stats.upload_bytes += bytes;
+    ++ctx.stats.sdl_calls;
+}
+
+// Creates a texture from a decoded image, counting the upload
+::SDL_Texture* surface_upload(canvas_context& ctx, ::SDL_Surface* surf) noexcept
+{
+    upload_count(ctx, static_cast<std::size_t>(surf->w) * static_cast<std::size_t>(surf->h) * 4);
+    return ::SDL_CreateTextureFromSurface(ctx.renderer, surf);
+}
+
+// Sets the SDL clip rectangle to the user clip rectangle, narrowed to the invalidated region when drawing into the frame
+void clip_apply(canvas_context& ctx) noexcept
+{
+    auto r = ctx.clip;
+    if (ctx.target == nullptr && ctx.invalidated) {
+        // A user clip outside the invalidated region leaves nothing to draw into
+        r = r ? rects_intersection(*r, *ctx.invalidated).value_or(rect{{}, {0, 0}}) : ctx.invalidated;
+    }
+    if (r) {
+        ::SDL_Rect clip{r->pos.x, r->pos.y, r->size.x, r->size.y};
+        ::SDL_RenderSetClipRect(ctx.renderer, &clip);
+    } else {
+        ::SDL_RenderSetClipRect(ctx.renderer, nullptr);
+    }
+    ++ctx.stats.sdl_calls;
+}
+
+// The size of what is currently drawn into: the target texture, the frame, or the renderer output
+vector target_size(canvas_context const& ctx) noexcept
+{
+    vector size;
+    if (ctx.target != nullptr) {
+        ::SDL_QueryTexture(ctx.target, nullptr, nullptr, &size.x, &size.y);
+    } else if (ctx.frame != nullptr) {
+        size = ctx.frame_size;
+    } else {
+        ::SDL_GetRendererOutputSize(ctx.renderer, &size.x, &size.y);
+    }
+    return size;
+}
+
+bool damage_tracked(canvas_context const& ctx) noexcept
+{
+    return ctx.frame != nullptr && ctx.target == nullptr;
+}
+
+// Records drawing into bounds as damage to the frame. Returns false if the frame is invalidated elsewhere, so that the
+// drawing can be skipped.
+bool damage_add(canvas_context& ctx, rect const& bounds) noexcept
+{
+    if (!damage_tracked(ctx)) {
+        return true;
+    }
+    if (ctx.invalidated) {
+        return rects_intersection(bounds, *ctx.invalidated).has_value();
+    }
+    auto visible = rects_intersection(bounds, {{}, ctx.frame_size});
+    if (visible && ctx.clip) {
+        visible = rects_intersection(*visible, *ctx.clip);
+    }
+    if (visible) {
+        rects_merge(ctx.damage, *visible, damage_rects_max);
+    }
+    return true;
+}
+
+// The pixels covered by a rectangle, which may have a negative size
+rect bounds(point const& p, vector const& s) noexcept
+{
+    return {{std::min(p.x, p.x + s.x), std::min(p.y, p.y + s.y)}, {std::abs(s.x), std::abs(s.y)}};
+}
+
+rect bounds(std::span<point const> ps) noexcept
+{
+    if (ps.empty()) {
+        return {};
+    }
+    auto x0 = ps.front().x, y0 = ps.front().y, x1 = x0, y1 = y0;
+    for (auto const& p : ps) {
+        x0 = std::min(x0, p.x);
+        y0 = std::min(y0, p.y);
+        x1 = std::max(x1, p.x);
+        y1 = std::max(y1, p.y);
+    }
+    return {{x0, y0}, {x1 - x0 + 1, y1 - y0 + 1}};
+}
+
+rect bounds(std::span<rect const> rs) noexcept
+{
+    if (rs.empty()) {
+        return {};
+    }
+    auto r = bounds(rs.front().pos, rs.front().size);
+    for (auto const& ri : rs.subspan(1)) {
+        r = rects_union(r, bounds(ri.pos, ri.size));
+    }
+    return r;
+}
+
+rect bounds(std::span<::SDL_Vertex const> vs) noexcept
+{
+    if (vs.empty()) {
+        return {};
+    }
+    auto x0 = vs.front().position.x, y0 = vs.front().position.y, x1 = x0, y1 = y0;
+    for (auto const& v : vs) {
+        x0 = std::min(x0, v.position.x);
+        y0 = std::min(y0, v.position.y);
+        x1 = std::max(x1, v.position.x);
+        y1 = std::max(y1, v.position.y);
+    }
+    auto const px = static_cast<int32_t>(std::floor(x0));
+    auto const py = static_cast<int32_t>(std::floor(y0));
+    return {{px, py}, {static_cast<int32_t>(std::ceil(x1)) - px, static_cast<int32_t>(std::ceil(y1)) - py}};
+}
+
+::SDL_BlendMode sdl_blend(blend b) noexcept
+{
+    switch (b) {
+    case blend::alpha:
+        return SDL_BLENDMODE_BLEND;
+    case blend::add:
+        return SDL_BLENDMODE_ADD;
+    case blend::mod:
+        return SDL_BLENDMODE_MOD;
+    case blend::none:
+        break;
+    }
+    return SDL_BLENDMODE_NONE;
+}
+
+font_context& font_ctx(void* font_handle) noexcept
+{
+    return *reinterpret_cast<font_context*>(font_handle);
+}
+
+void atlas_release(font_context& fc) noexcept
+{
+    auto& atlas = fc.atlas;
+    if (atlas.owner != nullptr) {
+        std::erase(atlas.owner->atlas_fonts, &fc);
+        ::SDL_DestroyTexture(atlas.texture);
+    }
+    atlas.evictions += atlas.glyphs.size();
+    atlas.glyphs.clear();
+    atlas.owner = nullptr;
+    atlas.texture = nullptr;
+    atlas.shelf_x = atlas.shelf_y = atlas.shelf_h = 0;
+}
+
+bool atlas_acquire(font_context& fc, canvas_context& ctx) noexcept
+{
+    auto& atlas = fc.atlas;
+    if (atlas.owner == &ctx) {
+        return true;
+    }
+    atlas_release(fc);
+
+    auto const height = ::TTF_FontHeight(fc.font);
+    atlas.side = 256;
+    while (atlas.side < height * 16 && atlas.side < 2048) {
+        atlas.side *= 2;
+    }
+    atlas.texture = ::SDL_CreateTexture(ctx.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, atlas.side, atlas.side);
+    if (atlas.texture == nullptr) {
+        return false;
+    }
+    ::SDL_SetTextureBlendMode(atlas.texture, SDL_BLENDMODE_BLEND);
+    atlas.owner = &ctx;
+    ctx.atlas_fonts.push_back(&fc);
+    return true;
+}
+
+// Decodes one UTF-8 sequence starting at text[i] and advances i past it
+uint32_t utf8_next(std::string_view text, std::size_t& i) noexcept
+{
+    auto const lead = static_cast<unsigned char>(text[i++]);
+    int32_t length = lead < 0x80 ? 0 : lead < 0xE0 ? 1 : lead < 0xF0 ? 2 : 3;
+    uint32_t cp = length == 0 ? lead : lead & (0x3Fu >> length);
+    for (; length > 0; --length) {
+        if (i == text.size() || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (static_cast<unsigned char>(text[i++]) & 0x3Fu);
+    }
+    return cp;
+}
+
+glyph_metrics const& metrics_find(font_context& fc, uint32_t cp) noexcept
+{
+    auto& m = cp < fc.ascii_metrics.size() ? fc.ascii_metrics[cp] : fc.metrics[cp];
+    if (!m.known) {
+        // Glyphs missing from the font measure as empty
+        int minx{}, maxx{}, miny{}, maxy{}, advance{};
+        if (::TTF_GlyphMetrics32(fc.font, cp, &minx, &maxx, &miny, &maxy, &advance) != 0) {
+            minx = maxx = advance = 0;
+        }
+        m = {minx, maxx, advance, true};
+    }
+    return m;
+}
+
+int32_t kerning_find(font_context& fc, uint32_t prev, uint32_t cp) noexcept
+{
+    auto const [it, inserted] = fc.kerning.try_emplace((uint64_t{prev} << 32) | cp);
+    if (inserted) {
+        it->second = ::TTF_GetFontKerningSizeGlyphs32(fc.font, prev, cp);
+    }
+    return it->second;
+}
+
+::SDL_Color sdl_color(color const& col) noexcept
+{
+    return {col.r, col.g, col.b, col.a};
+}
+
+// Reads straight from the given memory, which must outlive the returned stream
+::SDL_RWops* rw_open(std::span<std::byte const> bytes) noexcept
+{
+    return ::SDL_RWFromConstMem(bytes.data(), static_cast<int>(bytes.size()));
+}
+
+void push_quad(canvas_context& ctx, int32_t x0, int32_t y0, int32_t x1, int32_t y1, color const& col)
+{
+    auto const first = static_cast<int>(ctx.vertices.size());
+    auto const c = sdl_color(col);
+    ctx.vertices.push_back({{static_cast<float>(x0), static_cast<float>(y0)}, c, {}});
+    ctx.vertices.push_back({{static_cast<float>(x1), static_cast<float>(y0)}, c, {}});
+    ctx.vertices.push_back({{static_cast<float>(x1), static_cast<float>(y1)}, c, {}});
+    ctx.vertices.push_back({{static_cast<float>(x0), static_cast<float>(y1)}, c, {}});
+    for (int i : {0, 1, 2, 0, 2, 3}) {
+        ctx.indices.push_back(first + i);
+    }
+}
+
+void render_quads(canvas_context& ctx, ::SDL_Texture* texture = nullptr) noexcept
+{
+    if (!ctx.indices.empty()) {
+        ::SDL_RenderGeometry(ctx.renderer, texture, ctx.vertices.data(), static_cast<int>(ctx.vertices.size()), ctx.indices.data(), static_cast<int>(ctx.indices.size()));
+        ++ctx.stats.sdl_calls;
+    }
+    ctx.vertices.clear();
+    ctx.indices.clear();
+}
+
+void push_quad(canvas_context& ctx, ::SDL_Rect const& dst, ::SDL_Rect const& src, float scale_x, float scale_y, color const& col)
+{
+    auto const first = static_cast<int>(ctx.vertices.size());
+    auto const c = sdl_color(col);
+    auto const x0 = static_cast<float>(dst.x);
+    auto const y0 = static_cast<float>(dst.y);
+    auto const x1 = static_cast<float>(dst.x + dst.w);
+    auto const y1 = static_cast<float>(dst.y + dst.h);
+    auto const u0 = static_cast<float>(src.x) * scale_x;
+    auto const v0 = static_cast<float>(src.y) * scale_y;
+    auto const u1 = static_cast<float>(src.x + src.w) * scale_x;
+    auto const v1 = static_cast<float>(src.y + src.h) * scale_y;
+    ctx.vertices.push_back({{x0, y0}, c, {u0, v0}});
+    ctx.vertices.push_back({{x1, y0}, c, {u1, v0}});
+    ctx.vertices.push_back({{x1, y1}, c, {u1, v1}});
+    ctx.vertices.push_back({{x0, y1}, c, {u0, v1}});
+    for (int i : {0, 1, 2, 0, 2, 3}) {
+        ctx.indices.push_back(first + i);
+    }
+}
+
+void push_quad(canvas_context& ctx, ::SDL_Rect const& dst, ::SDL_Rect const& src, float scale, color const& col)
+{
+    push_quad(ctx, dst, src, scale, scale, col);
+}
+
+// Uploads the first size.x * size.y scratch pixels to the scratch texture
+bool scratch_upload(canvas_context& ctx, vector size, color const* pixels) noexcept
+{
+    // Width and height grow independently, so that a long strip such as a gradient row does not need a square texture
+    if (size.x > ctx.scratch_size.x || size.y > ctx.scratch_size.y) {
+        auto const grow = [](int32_t have, int32_t need) {
+            return need <= have ? have : static_cast<int32_t>(std::bit_ceil(static_cast<uint32_t>(need)));
+        };
+        vector const new_size{grow(ctx.scratch_size.x, size.x), grow(ctx.scratch_size.y, size.y)};
+        ::SDL_Texture* tp = ::SDL_CreateTexture(ctx.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, new_size.x, new_size.y);
+        if (tp == nullptr) {
+            return false;
+        }
+        ::SDL_SetTextureScaleMode(tp, SDL_ScaleModeNearest);
+        ::SDL_DestroyTexture(ctx.scratch);
+        ctx.scratch = tp;
+        ctx.scratch_size = new_size;
+    }
+    ::SDL_Rect area{0, 0, size.x, size.y};
+    ::SDL_SetTextureBlendMode(ctx.scratch, sdl_blend(ctx.mode));
+    upload_count(ctx, static_cast<std::size_t>(size.x) * static_cast<std::size_t>(size.y) * 4);
+    ++ctx.stats.sdl_calls;
+    return ::SDL_UpdateTexture(ctx.scratch, &area, pixels, size.x * 4) == 0;
+}
+
+bool scratch_upload(canvas_context& ctx, vector size) noexcept
+{
+    return scratch_upload(ctx, size, ctx.pixels.data());
+}
+
+void load_points(canvas_context& ctx, std::span<point const> ps)
+{
+    ctx.points.clear();
+    for (auto const& p : ps) {
+        ctx.points.push_back({p.x, p.y});
+    }
+}
+
+void load_rects(canvas_context& ctx, std::span<rect const> rs)
+{
+    ctx.rects.clear();
+    for (auto const& r : rs) {
+        ctx.rects.push_back({r.pos.x, r.pos.y, r.size.x, r.size.y});
+    }
+}
+
+cached_texture* cache_entry(::SDL_Texture* tp) noexcept
+{
+    return tp == nullptr ? nullptr : reinterpret_cast<cached_texture*>(::SDL_GetTextureUserData(tp));
+}
+
+// Marks a cached texture as the most recently used
+void cache_touch(canvas_context& ctx, ::SDL_Texture* tp) noexcept
+{
+    if (auto* e = cache_entry(tp); e != nullptr && e->resident) {
+        ctx.cache.lru.splice(ctx.cache.lru.end(), ctx.cache.lru, e->lru);
+    }
+}
+
+// Removes an entry from the cache. The texture lives on until its last reference is destroyed.
+void cache_evict(texture_cache& cache, cached_texture& e) noexcept
+{
+    for (auto const& path : e.paths) {
+        cache.paths.erase(path);
+    }
+    if (e.hash) {
+        cache.contents.erase(*e.hash);
+    }
+    cache.lru.erase(e.lru);
+    e.resident = false;
+    cache.stats.bytes -= e.bytes;
+    --cache.stats.entries;
+    if (e.refs == 0) {
+        ::SDL_DestroyTexture(e.texture);
+        delete &e;
+    }
+}
+
+// Evicts least recently used entries until the cache fits its budget. Referenced entries are kept, since evicting them
+// would free no memory and a later load of the same file would upload a second copy. The cache is trimmed again when
+// their last reference is destroyed.
+void cache_trim(texture_cache& cache) noexcept
+{
+    auto it = cache.lru.begin();
+    while (cache.stats.bytes > cache.budget && it != cache.lru.end()) {
+        auto* e = *it++;
+        if (e->refs == 0) {
+            cache_evict(cache, *e);
+            ++cache.stats.evictions;
+        }
+    }
+}
+
+void cache_clear(texture_cache& cache) noexcept
+{
+    while (!cache.lru.empty()) {
+        cache_evict(cache, *cache.lru.front());
+    }
+}
+
+// FNV-1a
+uint64_t content_hash(std::span<char const> bytes) noexcept
+{
+    uint64_t h = 14695981039346656037u;
+    for (auto const c : bytes) {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211u;
+    }
+    return h ^ bytes.size();
+}
+
+std::optional<std::vector<char>> file_read(std::filesystem::path const& path)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+        return {};
+    }
+    return std::vector<char>{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+void loader_run(texture_loader& loader)
+{
+    for (;;) {
+        texture_job job;
+        {
+            std::unique_lock lock{loader.mutex};
+            loader.wake.wait(lock, [&] { return loader.stop || !loader.jobs.empty(); });
+            if (loader.stop) {
+                return;
+            }
+            job = std::move(loader.jobs.front());
+            loader.jobs.pop_front();
+        }
+        ::SDL_Surface* surf = ::IMG_Load(job.path.string().c_str());
+        std::lock_guard lock{loader.mutex};
+        loader.decoded.push_back({surf, std::move(job.done)});
+    }
+}
+
+texture_loader& loader_get(canvas_context& ctx)
+{
+    if (!ctx.loader) {
+        ctx.loader = std::make_unique<texture_loader>();
+        // Leave a core for the render thread
+        auto const threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned i = 0; i < threads; ++i) {
+            ctx.loader->workers.emplace_back(loader_run, std::ref(*ctx.loader));
+        }
+    }
+    return *ctx.loader;
+}
+
+// Stops the loader threads and fails all loads that have not completed
+void loader_stop(canvas_context& ctx) noexcept
+{
+    if (ctx.loader) {
+        auto& loader = *ctx.loader;
+        {
+            std::lock_guard lock{loader.mutex};
+            loader.stop = true;
+        }
+        loader.wake.notify_all();
+        for (auto& worker : loader.workers) {
+            worker.join();
+        }
+        for (auto& job : loader.jobs) {
+            job.done(nullptr);
+        }
+        for (auto& upload : loader.decoded) {
+            ctx.uploads.push_back(std::move(upload));
+        }
+        ctx.loader.reset();
+    }
+    for (auto& upload : ctx.uploads) {
+        ::SDL_FreeSurface(upload.surface);
+        upload.done(nullptr);
+    }
+    ctx.uploads.clear();
+}
+
+// Uploads decoded images in the order they were decoded, until the budget for this frame is spent. At least one image
+// is uploaded per frame, so images larger than the budget still load.
+void uploads_process(canvas_context& ctx)
+{
+    if (ctx.loader) {
+        std::lock_guard lock{ctx.loader->mutex};
+        for (auto& upload : ctx.loader->decoded) {
+            ctx.uploads.push_back(std::move(upload));
+        }
+        ctx.loader->decoded.clear();
+    }
+
+    std::size_t spent{};
+    while (!ctx.uploads.empty()) {
+        auto upload = std::move(ctx.uploads.front());
+        auto const bytes = upload.surface == nullptr ? 0 : static_cast<std::size_t>(upload.surface->w) * static_cast<std::size_t>(upload.surface->h) * 4;
+        if (spent > 0 && spent + bytes > ctx.upload_budget) {
+            ctx.uploads.front() = std::move(upload);
+            break;
+        }
+        ctx.uploads.pop_front();
+        ::SDL_Texture* tp{};
+        if (upload.surface != nullptr) {
+            tp = surface_upload(ctx, upload.surface);
+            ::SDL_FreeSurface(upload.surface);
+        }
+        spent += bytes;
+        upload.done(tp);
+    }
+}
+
+atlas_context& atlas_ctx(void* atlas_handle) noexcept
+{
+    return *reinterpret_cast<atlas_context*>(atlas_handle);
+}
+
+// Finds the lowest position on a page where a w * h image fits on top of the skyline, preferring narrow segments to
+// reduce wasted space. Returns the index of the first skyline node under the image.
+std::optional<std::size_t> skyline_find(atlas_page const& page, vector page_size, int32_t w, int32_t h, int32_t& y) noexcept
+{
+    std::optional<std::size_t> best;
+    auto best_top = page_size.y;
+    auto best_w = page_size.x;
+    auto const& nodes = page.skyline;
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].x + w > page_size.x) {
+            break;
+        }
+        // The image rests on the highest node it spans
+        auto top = 0;
+        auto remaining = w;
+        for (auto j = i; remaining > 0; ++j) {
+            top = std::max(top, nodes[j].y);
+            remaining -= nodes[j].w;
+        }
+        if (top + h <= page_size.y && (top + h < best_top || (top + h == best_top && nodes[i].w < best_w))) {
+            best = i;
+            best_top = top + h;
+            best_w = nodes[i].w;
+            y = top;
+        }
+    }
+    return best;
+}
+
+// Raises the skyline under a w * h image placed at node i and height y
+void skyline_insert(atlas_page& page, std::size_t i, int32_t y, int32_t w, int32_t h)
+{
+    auto& nodes = page.skyline;
+    skyline_node const node{nodes[i].x, y + h, w};
+    nodes.insert(nodes.begin() + static_cast<std::ptrdiff_t>(i), node);
+
+    // Shrink or remove the nodes now covered by the image
+    auto const right = node.x + node.w;
+    auto j = i + 1;
+    while (j < nodes.size() && nodes[j].x < right) {
+        auto const shrink = right - nodes[j].x;
+        if (shrink < nodes[j].w) {
+            nodes[j].x += shrink;
+            nodes[j].w -= shrink;
+            break;
+        }
+        nodes.erase(nodes.begin() + static_cast<std::ptrdiff_t>(j));
+    }
+
+    // Merge neighbours at the same height
+    for (std::size_t k = 0; k + 1 < nodes.size();) {
+        if (nodes[k].y == nodes[k + 1].y) {
+            nodes[k].w += nodes[k + 1].w;
+            nodes.erase(nodes.begin() + static_cast<std::ptrdiff_t>(k + 1));
+        } else {
+            ++k;
+        }
+    }
+}
+
+// Copies a w * h image into the middle of a (w + 2) * (h + 2) buffer, repeating its edge pixels in the border
+std::vector<color> atlas_extrude(void const* pixels, int32_t pitch, int32_t w, int32_t h)
+{
+    auto const pw = static_cast<std::size_t>(w) + 2;
+    std::vector<color> out(pw * (static_cast<std::size_t>(h) + 2));
+    for (int32_t y = -1; y <= h; ++y) {
+        auto const* src = reinterpret_cast<color const*>(static_cast<std::byte const*>(pixels) + static_cast<std::ptrdiff_t>(std::clamp(y, 0, h - 1)) * pitch);
+        auto* dst = out.data() + static_cast<std::size_t>(y + 1) * pw;
+        dst[0] = src[0];
+        std::copy_n(src, w, dst + 1);
+        dst[pw - 1] = src[w - 1];
+    }
+    return out;
+}
+
+// Packs a w * h image into the first page with room, adding a page when all are full
+std::optional<sprite> atlas_pack(atlas_context& actx, void const* pixels, int32_t pitch, int32_t w, int32_t h) noexcept
+{
+    // Each image is surrounded by a one pixel border repeating its edge pixels, so that filtering at its edges samples
+    // the image itself rather than its neighbours
+    auto const pw = w + 2;
+    auto const ph = h + 2;
+    if (w <= 0 || h <= 0 || pw > actx.page_size.x || ph > actx.page_size.y) {
+        return {};
+    }
+
+    for (std::size_t n = 0;; ++n) {
+        if (n == actx.pages.size()) {
+            ::SDL_Texture* tp = ::SDL_CreateTexture(actx.canvas->renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, actx.page_size.x, actx.page_size.y);
+            if (tp == nullptr) {
+                return {};
+            }
+            // The contents of a new texture are undefined, so pages start out transparent
+            std::vector<color> const clear(static_cast<std::size_t>(actx.page_size.x) * static_cast<std::size_t>(actx.page_size.y), color{0, 0, 0, 0});
+            ::SDL_UpdateTexture(tp, nullptr, clear.data(), actx.page_size.x * 4);
+            upload_count(*actx.canvas, clear.size() * 4);
+            ::SDL_SetTextureBlendMode(tp, SDL_BLENDMODE_BLEND);
+            actx.pages.push_back({tp, {{0, 0, actx.page_size.x}}});
+        }
+        auto& page = actx.pages[n];
+        int32_t y{};
+        if (auto const i = skyline_find(page, actx.page_size, pw, ph, y)) {
+            sprite s{static_cast<uint32_t>(n), {{page.skyline[*i].x + 1, y + 1}, {w, h}}};
+            skyline_insert(page, *i, y, pw, ph);
+            auto const padded = atlas_extrude(pixels, pitch, w, h);
+            ::SDL_Rect const area{s.area.pos.x - 1, s.area.pos.y - 1, pw, ph};
+            ::SDL_UpdateTexture(page.texture, &area, padded.data(), pw * 4);
+            upload_count(*actx.canvas, padded.size() * 4);
+            return s;
+        }
+    }
+}
+
+}
+
+namespace {
+
+// Used by font::load, created and released with the global context
+font_library_context* default_font_library{};
+
+void font_library_release(font_library_context* lib) noexcept
+{
+    if (lib != nullptr && --lib->refs == 0) {
+        delete lib;
+    }
+}
+
+}
+
+void global_context_destroy() noexcept
+{
+    font_library_release(std::exchange(default_font_library, nullptr));
+    ::TTF_Quit();
+}
+
+void global_context_create() noexcept
+{
+    ::TTF_Init();
+    default_font_library = new (std::nothrow) font_library_context{};
+}
+
+std::optional<rect> rects_intersection(rect const& a, rect const& b) noexcept
+{
+    auto const x0 = std::max(a.pos.x, b.pos.x);
+    auto const y0 = std::max(a.pos.y, b.pos.y);
+    auto const x1 = std::min(a.pos.x + a.size.x, b.pos.x + b.size.x);
+    auto const y1 = std::min(a.pos.y + a.size.y, b.pos.y + b.size.y);
+    if (x1 <= x0 || y1 <= y0) {
+        return {};
+    }
+    return rect{{x0, y0}, {x1 - x0, y1 - y0}};
+}
+
+rect rects_union(rect const& a, rect const& b) noexcept
+{
+    auto const x0 = std::min(a.pos.x, b.pos.x);
+    auto const y0 = std::min(a.pos.y, b.pos.y);
+    auto const x1 = std::max(a.pos.x + a.size.x, b.pos.x + b.size.x);
+    auto const y1 = std::max(a.pos.y + a.size.y, b.pos.y + b.size.y);
+    return {{x0, y0}, {x1 - x0, y1 - y0}};
+}
+
+// Adds r to rs, merging it with the rectangles it overlaps or touches. When rs grows beyond max rectangles they are
+// replaced by their bounding box.
+void rects_merge(std::vector<rect>& rs, rect const& r, std::size_t max) noexcept
+{
+    auto merged = r;
+    for (auto i = rs.begin(); i != rs.end();) {
+        auto const touch = i->pos.x <= merged.pos.x + merged.size.x && merged.pos.x <= i->pos.x + i->size.x && i->pos.y <= merged.pos.y + merged.size.y && merged.pos.y <= i->pos.y + i->size.y;
+        if (touch) {
+            merged = rects_union(*i, merged);
+            i = rs.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    rs.push_back(merged);
+    if (rs.size() > max) {
+        for (auto const& d : rs) {
+            merged = rects_union(merged, d);
+        }
+        rs.assign(1, merged);
+    }
+}
+
+void atlas_destroy(void* handle) noexcept
+{
+    if (handle) {
+        for (auto const& page : atlas_ctx(handle).pages) {
+            ::SDL_DestroyTexture(page.texture);
+        }
+        delete &atlas_ctx(handle);
+    }
+}
+
+void* atlas_create(void* canvas_handle, vector page_size) noexcept
+{
+    if (canvas_handle == nullptr || page_size.x <= 0 || page_size.y <= 0) {
+        return nullptr;
+    }
+    return new (std::nothrow) atlas_context{&context(canvas_handle), page_size};
+}
+
+namespace {
+
+// Converts a decoded image to RGBA and packs it, taking ownership of the surface
+std::optional<sprite> atlas_add_surface(atlas_context& actx, ::SDL_Surface* surf) noexcept
+{
+    if (surf == nullptr) {
+        return {};
+    }
+    ::SDL_Surface* rgba = ::SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_RGBA32, 0);
+    ::SDL_FreeSurface(surf);
+    if (rgba == nullptr) {
+        return {};
+    }
+    auto const s = atlas_pack(actx, rgba->pixels, rgba->pitch, rgba->w, rgba->h);
+    ::SDL_FreeSurface(rgba);
+    return s;
+}
+
+}
+
+std::optional<sprite> atlas_add(void* handle, std::filesystem::path const& path) noexcept
+{
+    return atlas_add_surface(atlas_ctx(handle), ::IMG_Load(path.string().c_str()));
+}
+
+std::optional<sprite> atlas_add(void* handle, std::span<std::byte const> bytes) noexcept
+{
+    return atlas_add_surface(atlas_ctx(handle), ::IMG_Load_RW(rw_open(bytes), 1));
+}
+
+std::optional<sprite> atlas_add(void* handle, std::span<color const> pixels, vector size) noexcept
+{
+    if (pixels.size() < static_cast<std::size_t>(size.x) * static_cast<std::size_t>(size.y)) {
+        return {};
+    }
+    return atlas_pack(atlas_ctx(handle), pixels.data(), size.x * 4, size.x, size.y);
+}
+
+std::size_t atlas_pages(void* handle) noexcept
+{
+    return atlas_ctx(handle).pages.size();
+}
+
+std::optional<std::span<std::byte const>> file_map(std::filesystem::path const& path) noexcept
+{
+#if defined(_WIN32)
+    ::HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return {};
+    }
+    ::LARGE_INTEGER size{};
+    if (!::GetFileSizeEx(file, &size)) {
+        ::CloseHandle(file);
+        return {};
+    }
+    // An empty file cannot be mapped, but opens as an empty span
+    if (size.QuadPart == 0) {
+        ::CloseHandle(file);
+        return std::span<std::byte const>{};
+    }
+    // The view keeps the mapping and the file open after their handles are closed
+    ::HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    if (mapping == nullptr) {
+        return {};
+    }
+    void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    ::CloseHandle(mapping);
+    if (data == nullptr) {
+        return {};
+    }
+    return std::span{static_cast<std::byte const*>(data), static_cast<std::size_t>(size.QuadPart)};
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return {};
+    }
+    struct ::stat st{};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return {};
+    }
+    // An empty file cannot be mapped, but opens as an empty span
+    if (st.st_size == 0) {
+        ::close(fd);
+        return std::span<std::byte const>{};
+    }
+    auto const size = static_cast<std::size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return {};
+    }
+    return std::span{static_cast<std::byte const*>(data), size};
+#endif
+}
+
+void file_unmap(std::span<std::byte const> bytes) noexcept
+{
+    if (bytes.data() == nullptr) {
+        return;
+    }
+#if defined(_WIN32)
+    ::UnmapViewOfFile(bytes.data());
+#else
+    ::munmap(const_cast<std::byte*>(bytes.data()), bytes.size());
+#endif
+}
+
+void font_destroy(void* handle) noexcept
+{
+    if (handle == nullptr || --font_ctx(handle).refs > 0) {
+        return;
+    }
+    auto& fc = font_ctx(handle);
+    atlas_release(fc);
+    ::TTF_CloseFont(fc.font);
+    if (fc.face != nullptr) {
+        fc.face->sizes.erase(fc.size);
+        // The default library lives as long as the program, so it drops the contents of files no font reads anymore
+        if (fc.face->sizes.empty() && fc.library == default_font_library) {
+            std::erase_if(fc.library->faces, [&](auto const& f) { return &f.second == fc.face; });
+        }
+    }
+    font_library_release(fc.library);
+    delete &fc;
+}
+
+void* font_share(void* handle) noexcept
+{
+    ++font_ctx(handle).refs;
+    return handle;
+}
+
+void font_library_destroy(void* handle) noexcept
+{
+    font_library_release(reinterpret_cast<font_library_context*>(handle));
+}
+
+void* font_library_create() noexcept
+{
+    return new (std::nothrow) font_library_context{};
+}
+
+void* font_library_default() noexcept
+{
+    return default_font_library;
+}
+
+void* font_library_load(void* handle, std::filesystem::path const& path, int32_t size) noexcept
+{
+    auto& lib = *reinterpret_cast<font_library_context*>(handle);
+    auto key = path.lexically_normal().string();
+    auto it = lib.faces.find(key);
+    if (it == lib.faces.end()) {
+        auto bytes = file_read(path);
+        if (!bytes) {
+            return nullptr;
+        }
+        it = lib.faces.emplace(std::move(key), font_face{std::move(*bytes)}).first;
+    }
+    auto& face = it->second;
+    if (auto sit = face.sizes.find(size); sit != face.sizes.end()) {
+        ++sit->second->refs;
+        return sit->second;
+    }
+
+    // SDL_ttf reads glyphs from the stream for as long as the font is open, the file contents stay with the library
+    ::TTF_Font* fp = ::TTF_OpenFontRW(rw_open(std::as_bytes(std::span{face.bytes})), 1, size);
+    auto* fc = fp == nullptr ? nullptr : new (std::nothrow) font_context{fp, {}, 1, &lib, &face, size};
+    if (fc == nullptr) {
+        if (fp != nullptr) {
+            ::TTF_CloseFont(fp);
+        }
+        // A file that is not a font, or a size it cannot be opened at, does not keep the file contents around
+        if (face.sizes.empty()) {
+            lib.faces.erase(it);
+        }
+        return nullptr;
+    }
+    ++lib.refs;
+    face.sizes.emplace(size, fc);
+    return fc;
+}
+
+font_library_stats font_library_stats_get(void* handle) noexcept
+{
+    font_library_stats stats;
+    for (auto const& [path, face] : reinterpret_cast<font_library_context*>(handle)->faces) {
+        ++stats.faces;
+        stats.sizes += face.sizes.size();
+        stats.bytes += face.bytes.size();
+    }
+    return stats;
+}
+
+void* font_create(std::span<std::byte const> bytes, int32_t size) noexcept
+{
+    // SDL_ttf reads glyphs from the stream for as long as the font is open
+    ::TTF_Font* fp = ::TTF_OpenFontRW(rw_open(bytes), 1, size);
+    if (fp == nullptr) {
+        return nullptr;
+    }
+    return new (std::nothrow) font_context{fp};
+}
+
+vector font_text_size(void* handle, std::string_view text) noexcept
+{
+    // The extent covers the ink of every glyph as well as its advance, like TTF_SizeUTF8
+    auto& fc = font_ctx(handle);
+    int32_t x{}, x0{}, x1{};
+    uint32_t prev{};
+    for (std::size_t i = 0; i < text.size();) {
+        auto const cp = utf8_next(text, i);
+        if (prev != 0) {
+            x += kerning_find(fc, prev, cp);
+        }
+        prev = cp;
+        auto const& m = metrics_find(fc, cp);
+        x0 = std::min(x0, x + m.minx);
+        x1 = std::max(x1, x + std::max(m.maxx, m.advance));
+        x += m.advance;
+    }
+    return {x1 - x0, ::TTF_FontHeight(fc.font)};
+}
+
+void font_text_sizes(void* handle, std::span<std::string_view const> texts, std::span<vector> out) noexcept
+{
+    auto const n = std::min(texts.size(), out.size());
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = font_text_size(handle, texts[i]);
+    }
+}
+
+glyph_atlas_stats font_atlas_stats(void* handle) noexcept
+{
+    auto const& atlas = font_ctx(handle).atlas;
+    return {atlas.hits, atlas.misses, atlas.evictions};
+}
+
+void window_destroy(void* handle) noexcept
+{
+    ::SDL_DestroyWindow(reinterpret_cast<::SDL_Window*>(handle));
+}
+
+void* window_create(point pos, vector size, std::string const& title, visibility vis) noexcept
+{
+    ::Uint32 v = SDL_WINDOW_SHOWN;
+    if (vis == visibility::off) {
+        v = SDL_WINDOW_HIDDEN;
+    }
+
+    void* handle;
+    if (size == vector{}) {
+        handle = ::SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, size.x, size.y, SDL_WINDOW_FULLSCREEN_DESKTOP | v);
+    } else {
+        if (pos == point{}) {
+            handle = ::SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, size.x, size.y, v);
+        } else {
+            handle = ::SDL_CreateWindow(title.c_str(), pos.x, pos.y, size.x, size.y, v);
+        }
+    }
+
+    return handle;
+}
+
+void window_show(void* handle) noexcept
+{
+    ::SDL_ShowWindow(reinterpret_cast<::SDL_Window*>(handle));
+}
+
+void window_hide(void* handle) noexcept
+{
+    ::SDL_HideWindow(reinterpret_cast<::SDL_Window*>(handle));
+}
+
+// Translates the next SDL event that has a gfx counterpart, skipping the others
+bool event_next(event& e) noexcept
+{
+    ::SDL_Event sdl_e;
+    while (::SDL_PollEvent(&sdl_e) != 0) {
+        e = {};
+        e.time = std::chrono::milliseconds{sdl_e.common.timestamp};
+        switch (sdl_e.type) {
+        case ::SDL_QUIT:
+            e.type = event_type::quit;
+            return true;
+        case ::SDL_WINDOWEVENT:
+            if (sdl_e.window.event == ::SDL_WINDOWEVENT_CLOSE) {
+                e.type = event_type::window_close;
+                return true;
+            }
+            if (sdl_e.window.event == ::SDL_WINDOWEVENT_SIZE_CHANGED) {
+                e.type = event_type::window_resize;
+                e.delta = {sdl_e.window.data1, sdl_e.window.data2};
+                return true;
+            }
+            break;
+        case ::SDL_KEYDOWN:
+        case ::SDL_KEYUP:
+            e.type = sdl_e.type == ::SDL_KEYDOWN ? event_type::key_down : event_type::key_up;
+            e.key = sdl_e.key.keysym.sym;
+            e.scancode = sdl_e.key.keysym.scancode;
+            e.mods = sdl_e.key.keysym.mod;
+            e.repeat = sdl_e.key.repeat != 0;
+            return true;
+        case ::SDL_MOUSEMOTION:
+            e.type = event_type::mouse_motion;
+            e.pos = {sdl_e.motion.x, sdl_e.motion.y};
+            e.delta = {sdl_e.motion.xrel, sdl_e.motion.yrel};
+            return true;
+        case ::SDL_MOUSEBUTTONDOWN:
+        case ::SDL_MOUSEBUTTONUP:
+            e.type = sdl_e.type == ::SDL_MOUSEBUTTONDOWN ? event_type::mouse_down : event_type::mouse_up;
+            e.pos = {sdl_e.button.x, sdl_e.button.y};
+            e.button = sdl_e.button.button;
+            return true;
+        case ::SDL_MOUSEWHEEL:
+            e.type = event_type::mouse_wheel;
+            e.delta = {sdl_e.wheel.x, sdl_e.wheel.y};
+            return true;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+void texture_destroy(void* handle) noexcept
+{
+    auto* tp = reinterpret_cast<::SDL_Texture*>(handle);
+    if (auto* e = cache_entry(tp)) {
+        // Cached textures are destroyed when they are neither referenced nor resident
+        if (--e->refs == 0) {
+            if (!e->resident) {
+                ::SDL_DestroyTexture(tp);
+                delete e;
+            } else {
+                cache_trim(*e->cache);
+            }
+        }
+        return;
+    }
+    ::SDL_DestroyTexture(tp);
+}
+
+void* texture_load(void* handle, std::filesystem::path const& path) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    ::SDL_Texture* tp{};
+    ::SDL_Surface* surf = ::IMG_Load(path.string().c_str());
+    if (surf != nullptr) {
+        tp = surface_upload(context(handle), surf);
+        ::SDL_FreeSurface(surf);
+    }
+    return tp;
+}
+
+void* texture_load_cached(void* handle, std::filesystem::path const& path) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    auto& ctx = context(handle);
+    auto& cache = ctx.cache;
+    auto const share = [&](cached_texture& e) {
+        ++cache.stats.hits;
+        ++e.refs;
+        cache_touch(ctx, e.texture);
+        return e.texture;
+    };
+
+    auto key = path.lexically_normal().string();
+    if (auto it = cache.paths.find(key); it != cache.paths.end()) {
+        return share(*it->second);
+    }
+
+    ::SDL_Surface* surf{};
+    std::optional<uint64_t> hash;
+    if (cache.mode == dedupe::content) {
+        // Identical files under different paths share one texture, and the file is decoded from the bytes already read
+        auto const bytes = file_read(path);
+        if (!bytes) {
+            return nullptr;
+        }
+        hash = content_hash(*bytes);
+        if (auto it = cache.contents.find(*hash); it != cache.contents.end()) {
+            it->second->paths.push_back(key);
+            cache.paths.emplace(std::move(key), it->second);
+            return share(*it->second);
+        }
+        surf = ::IMG_Load_RW(rw_open(std::as_bytes(std::span{*bytes})), 1);
+    } else {
+        surf = ::IMG_Load(path.string().c_str());
+    }
+    ++cache.stats.misses;
+    if (surf == nullptr) {
+        return nullptr;
+    }
+    ::SDL_Texture* tp = surface_upload(ctx, surf);
+    auto const size = static_cast<std::size_t>(surf->w) * static_cast<std::size_t>(surf->h) * 4;
+    ::SDL_FreeSurface(surf);
+    if (tp == nullptr) {
+        return nullptr;
+    }
+
+    auto* e = new (std::nothrow) cached_texture{tp, {key}, hash, size, 1, true, {}, &cache};
+    if (e == nullptr) {
+        return tp;
+    }
+    ::SDL_SetTextureUserData(tp, e);
+    e->lru = cache.lru.insert(cache.lru.end(), e);
+    cache.paths.emplace(std::move(key), e);
+    if (hash) {
+        cache.contents.emplace(*hash, e);
+    }
+    cache.stats.bytes += size;
+    ++cache.stats.entries;
+    cache_trim(cache);
+    return tp;
+}
+
+void texture_load_async(void* handle, std::filesystem::path const& path, std::function<void(void*)> done) noexcept
+{
+    if (handle == nullptr) {
+        done(nullptr);
+        return;
+    }
+    auto& loader = loader_get(context(handle));
+    {
+        std::lock_guard lock{loader.mutex};
+        loader.jobs.push_back({path, std::move(done)});
+    }
+    loader.wake.notify_one();
+}
+
+void* texture_load(void* handle, std::span<std::byte const> bytes) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    ::SDL_Texture* tp{};
+    ::SDL_Surface* surf = ::IMG_Load_RW(rw_open(bytes), 1);
+    if (surf != nullptr) {
+        tp = surface_upload(context(handle), surf);
+        ::SDL_FreeSurface(surf);
+    }
+    return tp;
+}
+
+void* texture_create_streaming(void* handle, vector size) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    ::SDL_Texture* tp = ::SDL_CreateTexture(renderer(handle), SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, size.x, size.y);
+    if (tp != nullptr) {
+        ::SDL_SetTextureBlendMode(tp, SDL_BLENDMODE_BLEND);
+    }
+    return tp;
+}
+
+void* texture_create_target(void* handle, vector size) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    auto& ctx = context(handle);
+    ::SDL_Texture* tp = ::SDL_CreateTexture(ctx.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, size.x, size.y);
+    if (tp == nullptr) {
+        return nullptr;
+    }
+    ::SDL_SetTextureBlendMode(tp, SDL_BLENDMODE_BLEND);
+
+    // The contents of a new target texture are undefined, so it is cleared once, and drawing goes back to where it was
+    if (::SDL_SetRenderTarget(ctx.renderer, tp) == 0) {
+        color_apply(ctx, {0, 0, 0, 0});
+        ::SDL_RenderClear(ctx.renderer);
+        ::SDL_SetRenderTarget(ctx.renderer, ctx.target != nullptr ? ctx.target : ctx.frame);
+        ctx.stats.sdl_calls += 3;
+        clip_apply(ctx);
+    }
+    return tp;
+}
+
+void texture_update(void* canvas_handle, void* handle, rect const& r, color const* pixels, int32_t pitch) noexcept
+{
+    ::SDL_Rect area{r.pos.x, r.pos.y, r.size.x, r.size.y};
+    ::SDL_UpdateTexture(reinterpret_cast<::SDL_Texture*>(handle), &area, pixels, pitch * 4);
+    upload_count(context(canvas_handle), static_cast<std::size_t>(r.size.x) * static_cast<std::size_t>(r.size.y) * 4);
+}
+
+vector texture_size(void* handle) noexcept
+{
+    vector size;
+    if (handle) {
+        ::SDL_QueryTexture(reinterpret_cast<::SDL_Texture*>(handle), nullptr, nullptr, &size.x, &size.y);
+    }
+    return size;
+}
+
+void* text_texture_create(void* handle, std::string const& text, void* font_handle, color const& col) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    ::SDL_Texture* tp{};
+    auto& ctx = context(handle);
+    ::SDL_Surface* surf = ::TTF_RenderUTF8_Solid(font_ctx(font_handle).font, text.c_str(), sdl_color(col));
+    ++ctx.stats.rasterizations;
+    if (surf != nullptr) {
+        tp = surface_upload(ctx, surf);
+        ::SDL_FreeSurface(surf);
+    }
+    return tp;
+}
+
+void canvas_destroy(void* handle) noexcept
+{
+    if (handle) {
+        loader_stop(context(handle));
+        cache_clear(context(handle).cache);
+        while (!context(handle).atlas_fonts.empty()) {
+            atlas_release(*context(handle).atlas_fonts.back());
+        }
+        ::SDL_DestroyTexture(context(handle).scratch);
+        ::SDL_DestroyTexture(context(handle).frame);
+        ::SDL_DestroyRenderer(renderer(handle));
+        ::SDL_FreeSurface(context(handle).surface);
+        delete &context(handle);
+    }
+}
+
+namespace {
+
+canvas_context* canvas_context_create(::SDL_Renderer* rp, ::SDL_Surface* surf) noexcept
+{
+    if (rp == nullptr) {
+        ::SDL_FreeSurface(surf);
+        return nullptr;
+    }
+    ::SDL_SetRenderDrawBlendMode(rp, SDL_BLENDMODE_NONE);
+    auto* ctx = new (std::nothrow) canvas_context{};
+    if (ctx == nullptr) {
+        ::SDL_DestroyRenderer(rp);
+        ::SDL_FreeSurface(surf);
+        return nullptr;
+    }
+    ctx->renderer = rp;
+    ctx->surface = surf;
+    ::SDL_GetRenderDrawColor(rp, &ctx->col.r, &ctx->col.g, &ctx->col.b, &ctx->col.a);
+    ctx->sdl_col = ctx->col;
+    ctx->mode = blend::none;
+    ::SDL_RendererInfo info{};
+    ctx->backbuffer_kept = ::SDL_GetRendererInfo(rp, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE) != 0;
+    return ctx;
+}
+
+}
+
+void* canvas_create(void* window_handle, vsync vs) noexcept
+{
+    ::Uint32 flags = SDL_RENDERER_ACCELERATED;
+    if (vs == vsync::on) {
+        flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    return canvas_context_create(::SDL_CreateRenderer(reinterpret_cast<::SDL_Window*>(window_handle), -1, flags), nullptr);
+}
+
+void* canvas_create_headless(vector size) noexcept
+{
+    // The software renderer draws straight into the surface and needs neither a window nor a video driver
+    ::SDL_Surface* surf = ::SDL_CreateRGBSurfaceWithFormat(0, size.x, size.y, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surf == nullptr) {
+        return nullptr;
+    }
+    return canvas_context_create(::SDL_CreateSoftwareRenderer(surf), surf);
+}
+
+static_assert(sizeof(color) == 4, "color must match the layout of SDL_PIXELFORMAT_RGBA32");
+
+std::span<color const> canvas_pixels(void* handle) noexcept
+{
+    auto& ctx = context(handle);
+    if (ctx.surface == nullptr) {
+        return {};
+    }
+    ::SDL_RenderFlush(ctx.renderer);
+    return {reinterpret_cast<color const*>(ctx.surface->pixels), static_cast<std::size_t>(ctx.surface->w) * static_cast<std::size_t>(ctx.surface->h)};
+}
+
+color canvas_color_pick(void* handle, point const& p) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    color c;
+    ::SDL_Rect rect{p.x, p.y, 1, 1};
+    ::SDL_RenderReadPixels(renderer(handle), &rect, SDL_PIXELFORMAT_RGBA32, &c, 4);
+    return c;
+}
+
+bool canvas_read_pixels(void* handle, rect const& r, std::span<color> out) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    // SDL clips the rectangle to the target and packs the rows it reads, which would leave out partly or entirely stale
+    if (rects_intersection(r, {{}, target_size(context(handle))}) != r) {
+        return false;
+    }
+    ::SDL_Rect area{r.pos.x, r.pos.y, r.size.x, r.size.y};
+    return ::SDL_RenderReadPixels(renderer(handle), &area, SDL_PIXELFORMAT_RGBA32, out.data(), r.size.x * 4) == 0;
+}
 
-namespace v0 {
+vector canvas_size(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    vector size;
+    ::SDL_GetRendererOutputSize(renderer(handle), &size.x, &size.y);
+    return size;
+}
 
-namespace impl {
+color canvas_color_get(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).col;
+}
 
-void global_context_destroy() noexcept
+void canvas_color_set(void* handle, color const& col) noexcept
 {
-    ::TTF_Quit();
+    if (handle == nullptr) {
+        return;
+    }
+    context(handle).col = col;
 }
 
-void global_context_create() noexcept
+blend canvas_blend_get(void* handle) noexcept
 {
-    ::TTF_Init();
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).mode;
 }
 
-void font_destroy(void* handle) noexcept
+void canvas_blend_set(void* handle, blend b) noexcept
 {
-    ::TTF_CloseFont(reinterpret_cast<::TTF_Font*>(handle));
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (b == ctx.mode) {
+        ++ctx.stats.state.elided;
+    } else {
+        ::SDL_SetRenderDrawBlendMode(ctx.renderer, sdl_blend(b));
+        ctx.mode = b;
+        ++ctx.stats.state.changes;
+        ++ctx.stats.sdl_calls;
+    }
 }
 
-void* font_create(std::filesystem::path const& path, int32_t size) noexcept
+std::optional<rect> canvas_clip_get(void* handle) noexcept
 {
-    return ::TTF_OpenFont(path.string().c_str(), size);
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).clip;
 }
 
-vector font_text_size(void* handle, char const* text) noexcept
+void canvas_clip_set(void* handle, std::optional<rect> const& r) noexcept
 {
-    int w, h;
-    ::TTF_SizeUTF8(reinterpret_cast<::TTF_Font*>(handle), text, &w, &h);
-    return {w, h};
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (r == ctx.clip) {
+        ++ctx.stats.state.elided;
+    } else {
+        ctx.clip = r;
+        clip_apply(ctx);
+        ++ctx.stats.state.changes;
+    }
 }
 
-void window_destroy(void* handle) noexcept
+draw_state_stats canvas_state_stats(void* handle) noexcept
 {
-    ::SDL_DestroyWindow(reinterpret_cast<::SDL_Window*>(handle));
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).last_stats.state;
 }
 
-void* window_create(point pos, vector size, std::string const& title, visibility vis) noexcept
+frame_stats canvas_stats(void* handle) noexcept
 {
-    ::Uint32 v = SDL_WINDOW_SHOWN;
-    if (vis == visibility::off) {
-        v = SDL_WINDOW_HIDDEN;
+    if (handle == nullptr) {
+        return {};
+    }
+    auto const& ctx = context(handle);
+    auto stats = ctx.last_stats;
+    auto const n = std::min(ctx.frames, frame_times_max);
+    if (n == 0) {
+        return stats;
     }
+    auto times = ctx.frame_times;
+    auto const percentile = [&](std::size_t pct) {
+        auto const nth = times.begin() + static_cast<std::ptrdiff_t>((n - 1) * pct / 100);
+        std::nth_element(times.begin(), nth, times.begin() + static_cast<std::ptrdiff_t>(n));
+        return static_cast<double>(*nth);
+    };
+    stats.frame_ms_p50 = percentile(50);
+    stats.frame_ms_p90 = percentile(90);
+    stats.frame_ms_p99 = percentile(99);
+    return stats;
+}
 
-    void* handle;
-    if (size == vector{}) {
-        handle = ::SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, size.x, size.y, SDL_WINDOW_FULLSCREEN_DESKTOP | v);
-    } else {
-        if (pos == point{}) {
-            handle = ::SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, size.x, size.y, v);
-        } else {
-            handle = ::SDL_CreateWindow(title.c_str(), pos.x, pos.y, size.x, size.y, v);
+texture_cache_stats canvas_cache_stats(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).cache.stats;
+}
+
+std::size_t canvas_cache_budget_get(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).cache.budget;
+}
+
+void canvas_cache_budget_set(void* handle, std::size_t bytes) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    auto& cache = context(handle).cache;
+    cache.budget = bytes;
+    cache_trim(cache);
+}
+
+dedupe canvas_cache_dedupe_get(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).cache.mode;
+}
+
+void canvas_cache_dedupe_set(void* handle, dedupe d) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    context(handle).cache.mode = d;
+}
+
+void* canvas_target_get(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).target;
+}
+
+void canvas_target_set(void* handle, void* texture_handle) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    auto* tp = reinterpret_cast<::SDL_Texture*>(texture_handle);
+    if (tp == ctx.target || ::SDL_SetRenderTarget(ctx.renderer, tp != nullptr ? tp : ctx.frame) != 0) {
+        return;
+    }
+    // Clipping is off when drawing into a texture, and the window clip rectangle is restored when drawing into the window
+    // again
+    if (ctx.target == nullptr) {
+        ctx.window_clip = ctx.clip;
+    }
+    ctx.clip = tp == nullptr ? ctx.window_clip : std::nullopt;
+    ctx.target = tp;
+    clip_apply(ctx);
+    ++ctx.stats.state.changes;
+    ++ctx.stats.sdl_calls;
+}
+
+std::size_t canvas_upload_budget_get(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).upload_budget;
+}
+
+void canvas_upload_budget_set(void* handle, std::size_t bytes) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    context(handle).upload_budget = bytes;
+}
+
+redraw canvas_redraw_get(void* handle) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    return context(handle).redraw_mode;
+}
+
+void canvas_redraw_set(void* handle, redraw r) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (r == ctx.redraw_mode || ctx.target != nullptr) {
+        return;
+    }
+    ::SDL_Texture* frame{};
+    vector size{};
+    if (r == redraw::partial) {
+        ::SDL_GetRendererOutputSize(ctx.renderer, &size.x, &size.y);
+        frame = ::SDL_CreateTexture(ctx.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, size.x, size.y);
+        if (frame == nullptr) {
+            return;
         }
+        ::SDL_SetTextureBlendMode(frame, SDL_BLENDMODE_NONE);
+    }
+    if (::SDL_SetRenderTarget(ctx.renderer, frame) != 0) {
+        ::SDL_DestroyTexture(frame);
+        return;
+    }
+    ::SDL_DestroyTexture(ctx.frame);
+    ctx.redraw_mode = r;
+    ctx.frame = frame;
+    ctx.frame_size = size;
+    ctx.damage.clear();
+    ctx.last_damage.clear();
+    ctx.invalidated.reset();
+    clip_apply(ctx);
+    if (frame != nullptr) {
+        // The frame starts out black and fully damaged
+        color_apply(ctx, black);
+        ::SDL_RenderClear(ctx.renderer);
+        ctx.damage.push_back({{}, size});
     }
+}
 
-    return handle;
+void canvas_invalidate(void* handle, rect const& r) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    auto const visible = rects_intersection(r, {{}, ctx.frame_size});
+    if (ctx.frame == nullptr || !visible) {
+        return;
+    }
+    // What was drawn this frame before the region was invalidated must still be presented
+    auto region = ctx.invalidated.value_or(*visible);
+    for (auto const& d : ctx.damage) {
+        region = rects_union(region, d);
+    }
+    ctx.invalidated = rects_union(region, *visible);
+    ctx.damage.assign(1, *ctx.invalidated);
+    clip_apply(ctx);
 }
 
-void window_show(void* handle) noexcept
+std::span<rect const> canvas_damage(void* handle) noexcept
 {
-    ::SDL_ShowWindow(reinterpret_cast<::SDL_Window*>(handle));
+    return context(handle).last_damage;
 }
 
-void window_hide(void* handle) noexcept
+// A headless canvas drawing into its own framebuffer is locked in place. Anything else is read back into a buffer of
+// its own, so that drawing while locked does not overwrite it, and drawn back on unlock.
+basic_pixel_view<color> canvas_lock(void* handle, rect const& r) noexcept
 {
-    ::SDL_HideWindow(reinterpret_cast<::SDL_Window*>(handle));
+    if (handle == nullptr) {
+        return {};
+    }
+    auto& ctx = context(handle);
+    auto const area = rects_intersection(r, {{}, target_size(ctx)});
+    if (!area || ctx.locked) {
+        return {};
+    }
+    auto const w = static_cast<std::size_t>(area->size.x);
+    auto const h = static_cast<std::size_t>(area->size.y);
+    if (ctx.surface != nullptr && ctx.target == nullptr && ctx.frame == nullptr) {
+        ::SDL_RenderFlush(ctx.renderer);
+        auto const stride = static_cast<std::size_t>(ctx.surface->pitch) / sizeof(color);
+        auto* first = reinterpret_cast<color*>(ctx.surface->pixels) + static_cast<std::size_t>(area->pos.y) * stride + static_cast<std::size_t>(area->pos.x);
+        ctx.locked = area;
+        ctx.locked_in_place = true;
+        return {{first, (h - 1) * stride + w}, area->size, stride};
+    }
+    ctx.locked_pixels.resize(w * h);
+    ::SDL_Rect src{area->pos.x, area->pos.y, area->size.x, area->size.y};
+    ++ctx.stats.sdl_calls;
+    if (::SDL_RenderReadPixels(ctx.renderer, &src, SDL_PIXELFORMAT_RGBA32, ctx.locked_pixels.data(), area->size.x * 4) != 0) {
+        return {};
+    }
+    ctx.locked = area;
+    ctx.locked_in_place = false;
+    return {ctx.locked_pixels, area->size};
 }
 
-void texture_destroy(void* handle) noexcept
+void canvas_unlock(void* handle) noexcept
 {
-    ::SDL_DestroyTexture(reinterpret_cast<::SDL_Texture*>(handle));
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    auto const area = std::exchange(ctx.locked, std::nullopt);
+    if (!area || ctx.locked_in_place) {
+        return;
+    }
+    if (damage_add(ctx, *area) && scratch_upload(ctx, area->size, ctx.locked_pixels.data())) {
+        draw_count(ctx, ctx.stats.draw_calls.images, 2);
+        // The pixels replace what was there, whatever the blend mode of the canvas
+        ::SDL_SetTextureBlendMode(ctx.scratch, SDL_BLENDMODE_NONE);
+        ::SDL_Rect src{0, 0, area->size.x, area->size.y};
+        ::SDL_Rect dst{area->pos.x, area->pos.y, area->size.x, area->size.y};
+        ::SDL_RenderCopy(ctx.renderer, ctx.scratch, &src, &dst);
+    }
 }
 
-void* texture_load(void* handle, std::filesystem::path const& path) noexcept
+void canvas_draw_point(void* handle, point const& p, color const& col) noexcept
 {
-    ::SDL_Texture* tp{};
-    ::SDL_Surface* surf = ::IMG_Load(path.string().c_str());
-    if (surf != nullptr) {
-        tp = ::SDL_CreateTextureFromSurface(reinterpret_cast<::SDL_Renderer*>(handle), surf);
-        ::SDL_FreeSurface(surf);
+    if (handle == nullptr) {
+        return;
     }
-    return tp;
+    auto& ctx = context(handle);
+    if (!damage_add(ctx, {p, {1, 1}})) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.points, 1);
+    color_apply(ctx, col);
+    ::SDL_RenderDrawPoint(ctx.renderer, p.x, p.y);
 }
 
-vector texture_size(void* handle) noexcept
+void canvas_draw_points(void* handle, std::span<point const> ps, color const& col) noexcept
 {
-    vector size;
-    if (handle) {
-        ::SDL_QueryTexture(reinterpret_cast<::SDL_Texture*>(handle), nullptr, nullptr, &size.x, &size.y);
+    if (handle == nullptr) {
+        return;
     }
-    return size;
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(ps))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.points, 1);
+    load_points(ctx, ps);
+    color_apply(ctx, col);
+    ::SDL_RenderDrawPoints(ctx.renderer, ctx.points.data(), static_cast<int>(ctx.points.size()));
 }
 
-void canvas_destroy(void* handle) noexcept
+void canvas_draw_points(void* handle, std::span<point const> ps, std::span<color const> cols) noexcept
 {
-    ::SDL_DestroyRenderer(reinterpret_cast<::SDL_Renderer*>(handle));
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(ps.first(std::min(ps.size(), cols.size()))))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.points, 0);
+    for (std::size_t i = 0; i < ps.size() && i < cols.size(); ++i) {
+        push_quad(ctx, ps[i].x, ps[i].y, ps[i].x + 1, ps[i].y + 1, cols[i]);
+    }
+    render_quads(ctx);
 }
 
-void* canvas_create(void* window_handle, vsync vs) noexcept
+void canvas_draw_line(void* handle, point const& p0, point const& p1, color const& col) noexcept
 {
-    ::Uint32 flags = SDL_RENDERER_ACCELERATED;
-    if (vs == vsync::on) {
-        flags |= SDL_RENDERER_PRESENTVSYNC;
+    if (handle == nullptr) {
+        return;
     }
-    void* handle = ::SDL_CreateRenderer(reinterpret_cast<::SDL_Window*>(window_handle), -1, flags);
-    ::SDL_SetRenderDrawBlendMode(reinterpret_cast<::SDL_Renderer*>(handle), SDL_BLENDMODE_NONE);
-    return handle;
+    auto& ctx = context(handle);
+    if (point const ps[]{p0, p1}; !damage_add(ctx, bounds(ps))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.lines, 1);
+    color_apply(ctx, col);
+    ::SDL_RenderDrawLine(ctx.renderer, p0.x, p0.y, p1.x, p1.y);
 }
 
-color canvas_color_pick(void* handle, point const& p) noexcept
+void canvas_draw_lines(void* handle, std::span<point const> ps, color const& col) noexcept
 {
-    color c;
-    ::SDL_Rect rect{p.x, p.y, 1, 1};
-    ::SDL_RenderReadPixels(reinterpret_cast<::SDL_Renderer*>(handle), &rect, SDL_PIXELFORMAT_RGBA32, &c, 4);
-    return c;
+    if (handle == nullptr) {
+        return;
+    }
+    // SDL has no plural entry point for disjoint segments, but it queues consecutive line commands into one batch
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(ps.first(ps.size() & ~std::size_t{1})))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.lines, ps.size() / 2);
+    color_apply(ctx, col);
+    for (std::size_t i = 1; i < ps.size(); i += 2) {
+        ::SDL_RenderDrawLine(ctx.renderer, ps[i - 1].x, ps[i - 1].y, ps[i].x, ps[i].y);
+    }
 }
 
-vector canvas_size(void* handle) noexcept
+void canvas_draw_lines(void* handle, std::span<point const> ps, std::span<color const> cols) noexcept
 {
-    vector size;
-    ::SDL_GetRendererOutputSize(reinterpret_cast<::SDL_Renderer*>(handle), &size.x, &size.y);
-    return size;
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(ps.first(std::min(ps.size() & ~std::size_t{1}, cols.size() * 2))))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.lines, std::min(ps.size() / 2, cols.size()));
+    for (std::size_t i = 1, j = 0; i < ps.size() && j < cols.size(); i += 2, ++j) {
+        color_apply(ctx, cols[j]);
+        ::SDL_RenderDrawLine(ctx.renderer, ps[i - 1].x, ps[i - 1].y, ps[i].x, ps[i].y);
+    }
 }
 
-color canvas_color_get(void* handle) noexcept
+void canvas_draw_polyline(void* handle, std::span<point const> ps, color const& col) noexcept
 {
-    color c;
-    ::SDL_GetRenderDrawColor(reinterpret_cast<::SDL_Renderer*>(handle), &c.r, &c.g, &c.b, &c.a);
-    return c;
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(ps))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.lines, 1);
+    load_points(ctx, ps);
+    color_apply(ctx, col);
+    ::SDL_RenderDrawLines(ctx.renderer, ctx.points.data(), static_cast<int>(ctx.points.size()));
 }
 
-void canvas_color_set(void* handle, color const& col) noexcept
+void canvas_draw_polyline(void* handle, std::span<point const> ps, std::span<color const> cols) noexcept
 {
-    ::SDL_SetRenderDrawColor(reinterpret_cast<::SDL_Renderer*>(handle), col.r, col.g, col.b, col.a);
+    if (handle == nullptr) {
+        return;
+    }
+    // Consecutive segments of the same color are submitted as one polyline
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(ps.first(std::min(ps.size(), cols.size() + 1))))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.lines, 0);
+    load_points(ctx, ps);
+    auto const segments = ps.size() < 2 ? std::size_t{} : std::min(ps.size() - 1, cols.size());
+    for (std::size_t first = 0; first < segments;) {
+        auto last = first + 1;
+        while (last < segments && cols[last] == cols[first]) {
+            ++last;
+        }
+        color_apply(ctx, cols[first]);
+        ::SDL_RenderDrawLines(ctx.renderer, ctx.points.data() + first, static_cast<int>(last - first + 1));
+        ++ctx.stats.sdl_calls;
+        first = last;
+    }
 }
 
-void canvas_draw_point(void* handle, point const& p) noexcept
+void canvas_draw_rects(void* handle, std::span<rect const> rs, color const& col, fill f) noexcept
 {
-    ::SDL_RenderDrawPoint(reinterpret_cast<::SDL_Renderer*>(handle), p.x, p.y);
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(rs))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.rects, 1);
+    load_rects(ctx, rs);
+    color_apply(ctx, col);
+    if (f == fill::off) {
+        ::SDL_RenderDrawRects(ctx.renderer, ctx.rects.data(), static_cast<int>(ctx.rects.size()));
+    } else {
+        ::SDL_RenderFillRects(ctx.renderer, ctx.rects.data(), static_cast<int>(ctx.rects.size()));
+    }
 }
 
-void canvas_draw_line(void* handle, point const& p0, point const& p1) noexcept
+void canvas_draw_rects(void* handle, std::span<rect const> rs, std::span<color const> cols, fill f) noexcept
 {
-    ::SDL_RenderDrawLine(reinterpret_cast<::SDL_Renderer*>(handle), p0.x, p0.y, p1.x, p1.y);
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(rs.first(std::min(rs.size(), cols.size()))))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.rects, 0);
+    for (std::size_t i = 0; i < rs.size() && i < cols.size(); ++i) {
+        auto const x0 = rs[i].pos.x;
+        auto const y0 = rs[i].pos.y;
+        auto const x1 = x0 + rs[i].size.x;
+        auto const y1 = y0 + rs[i].size.y;
+        if (rs[i].size.x <= 0 || rs[i].size.y <= 0) {
+            continue;
+        }
+        if (f == fill::on || rs[i].size.x <= 2 || rs[i].size.y <= 2) {
+            push_quad(ctx, x0, y0, x1, y1, cols[i]);
+        } else {
+            push_quad(ctx, x0, y0, x1, y0 + 1, cols[i]);
+            push_quad(ctx, x0, y1 - 1, x1, y1, cols[i]);
+            push_quad(ctx, x0, y0 + 1, x0 + 1, y1 - 1, cols[i]);
+            push_quad(ctx, x1 - 1, y0 + 1, x1, y1 - 1, cols[i]);
+        }
+    }
+    render_quads(ctx);
 }
 
-void canvas_draw_rect(void* handle, point const& p, vector const& v, fill f) noexcept
+void canvas_draw_rect(void* handle, point const& p, vector const& v, color const& col, fill f) noexcept
 {
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (!damage_add(ctx, bounds(p, v))) {
+        return;
+    }
+    draw_count(ctx, ctx.stats.draw_calls.rects, 1);
     ::SDL_Rect rect{p.x, p.y, v.x, v.y};
+    color_apply(ctx, col);
     if (f == fill::off) {
-        ::SDL_RenderDrawRect(reinterpret_cast<::SDL_Renderer*>(handle), &rect);
+        ::SDL_RenderDrawRect(ctx.renderer, &rect);
     } else {
-        ::SDL_RenderFillRect(reinterpret_cast<::SDL_Renderer*>(handle), &rect);
+        ::SDL_RenderFillRect(ctx.renderer, &rect);
+    }
+}
+
+std::span<color> canvas_scratch_pixels(void* handle, vector size) noexcept
+{
+    if (handle == nullptr) {
+        return {};
+    }
+    auto& ctx = context(handle);
+    ctx.pixels.resize(static_cast<std::size_t>(size.x) * static_cast<std::size_t>(size.y));
+    return ctx.pixels;
+}
+
+void canvas_draw_scratch_pixels(void* handle, vector size, rect const& dst) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (damage_add(ctx, bounds(dst.pos, dst.size)) && scratch_upload(ctx, size)) {
+        draw_count(ctx, ctx.stats.draw_calls.images, 1);
+        ::SDL_Rect src{0, 0, size.x, size.y};
+        ::SDL_Rect area{dst.pos.x, dst.pos.y, dst.size.x, dst.size.y};
+        ::SDL_RenderCopy(ctx.renderer, ctx.scratch, &src, &area);
+    }
+}
+
+void canvas_draw_scratch_pixels(void* handle, vector size, point const& p, std::span<rect const> spans) noexcept
+{
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (damage_add(ctx, {p, size}) && scratch_upload(ctx, size)) {
+        draw_count(ctx, ctx.stats.draw_calls.images, 0);
+        auto const scale_x = 1.f / static_cast<float>(ctx.scratch_size.x);
+        auto const scale_y = 1.f / static_cast<float>(ctx.scratch_size.y);
+        for (auto const& span : spans) {
+            ::SDL_Rect src{span.pos.x, span.pos.y, span.size.x, span.size.y};
+            push_quad(ctx, {p.x + src.x, p.y + src.y, src.w, src.h}, src, scale_x, scale_y, white);
+        }
+        render_quads(ctx, ctx.scratch);
     }
 }
 
 void canvas_draw_texture(void* handle, void* texture_handle) noexcept
 {
-    ::SDL_RenderCopy(reinterpret_cast<::SDL_Renderer*>(handle), reinterpret_cast<::SDL_Texture*>(texture_handle), nullptr, nullptr);
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (!damage_add(ctx, {{}, ctx.frame_size})) {
+        return;
+    }
+    auto* texture = reinterpret_cast<::SDL_Texture*>(texture_handle);
+    draw_count(ctx, ctx.stats.draw_calls.textures, 1);
+    cache_touch(ctx, texture);
+    ::SDL_RenderCopy(ctx.renderer, texture, nullptr, nullptr);
 }
 
 void canvas_draw_texture(void* handle, void* texture_handle, point const& p) noexcept
 {
+    if (handle == nullptr) {
+        return;
+    }
     int w, h;
     ::SDL_QueryTexture(reinterpret_cast<::SDL_Texture*>(texture_handle), nullptr, nullptr, &w, &h);
     canvas_draw_texture(handle, texture_handle, p, {w, h});
@@ -195,47 +2207,252 @@ void canvas_draw_texture(void* handle, void* texture_handle, point const& p) noe
 
 void canvas_draw_texture(void* handle, void* texture_handle, point const& p, vector const& s) noexcept
 {
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (!damage_add(ctx, bounds(p, s))) {
+        return;
+    }
     ::SDL_Rect rect{p.x, p.y, s.x, s.y};
-    ::SDL_RenderCopy(reinterpret_cast<::SDL_Renderer*>(handle), reinterpret_cast<::SDL_Texture*>(texture_handle), nullptr, &rect);
+    auto* texture = reinterpret_cast<::SDL_Texture*>(texture_handle);
+    draw_count(ctx, ctx.stats.draw_calls.textures, 1);
+    cache_touch(ctx, texture);
+    ::SDL_RenderCopy(ctx.renderer, texture, nullptr, &rect);
 }
 
 void canvas_draw_texture(void* handle, void* texture_handle, point const& p, vector const& s, point const& tp, vector const& ts) noexcept
 {
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    if (!damage_add(ctx, bounds(p, s))) {
+        return;
+    }
     ::SDL_Rect trect{tp.x, tp.y, ts.x, ts.y};
     ::SDL_Rect rect{p.x, p.y, s.x, s.y};
-    ::SDL_RenderCopy(reinterpret_cast<::SDL_Renderer*>(handle), reinterpret_cast<::SDL_Texture*>(texture_handle), &trect, &rect);
+    auto* texture = reinterpret_cast<::SDL_Texture*>(texture_handle);
+    draw_count(ctx, ctx.stats.draw_calls.textures, 1);
+    cache_touch(ctx, texture);
+    ::SDL_RenderCopy(ctx.renderer, texture, &trect, &rect);
 }
 
-void canvas_draw_text(void* handle, std::string const& text, void* font_handle, point const& p, color const& col) noexcept
+void canvas_draw_sprites(void* handle, void* atlas_handle, std::span<sprite const> ss, std::span<point const> ps, std::span<vector const> sizes) noexcept
 {
-    ::SDL_Color color{col.r, col.g, col.b, col.a};
-    ::SDL_Surface* surf = ::TTF_RenderUTF8_Solid(reinterpret_cast<::TTF_Font*>(font_handle), text.c_str(), color);
-    ::SDL_Texture* text_texture = ::SDL_CreateTextureFromSurface(reinterpret_cast<::SDL_Renderer*>(handle), surf);
-    ::SDL_Rect dest = {p.x, p.y, surf->w, surf->h};
-    ::SDL_RenderCopy(reinterpret_cast<::SDL_Renderer*>(handle), text_texture, nullptr, &dest);
-    ::SDL_DestroyTexture(text_texture);
-    ::SDL_FreeSurface(surf);
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    auto const& actx = atlas_ctx(atlas_handle);
+    auto const scale_x = 1.f / static_cast<float>(actx.page_size.x);
+    auto const scale_y = 1.f / static_cast<float>(actx.page_size.y);
+
+    auto const n = std::min(ss.size(), ps.size());
+    if (damage_tracked(ctx) && n != 0) {
+        auto r = bounds(ps[0], 0 < sizes.size() ? sizes[0] : ss[0].area.size);
+        for (std::size_t i = 1; i < n; ++i) {
+            r = rects_union(r, bounds(ps[i], i < sizes.size() ? sizes[i] : ss[i].area.size));
+        }
+        if (!damage_add(ctx, r)) {
+            return;
+        }
+    }
+
+    draw_count(ctx, ctx.stats.draw_calls.sprites, 0);
+
+    // Consecutive sprites on the same page are drawn together, so draw order is kept when pages alternate
+    ::SDL_Texture* batch{};
+    for (std::size_t i = 0; i < n; ++i) {
+        if (ss[i].page >= actx.pages.size()) {
+            continue;
+        }
+        auto* tp = actx.pages[ss[i].page].texture;
+        if (tp != batch) {
+            render_quads(ctx, batch);
+            batch = tp;
+        }
+        auto const& area = ss[i].area;
+        auto const size = i < sizes.size() ? sizes[i] : area.size;
+        push_quad(ctx, {ps[i].x, ps[i].y, size.x, size.y}, {area.pos.x, area.pos.y, area.size.x, area.size.y}, scale_x, scale_y, white);
+    }
+    render_quads(ctx, batch);
 }
 
-void canvas_render(void* handle) noexcept
+namespace {
+
+// Looks up a glyph in the atlas of the given font, rasterizing and packing it on a miss
+glyph const* glyph_find(font_context& fc, canvas_context& ctx, uint32_t cp, glyph_mode mode) noexcept
 {
-    ::SDL_RenderPresent(reinterpret_cast<::SDL_Renderer*>(handle));
+    auto& atlas = fc.atlas;
+    auto const key = (uint64_t{static_cast<uint32_t>(mode)} << 32) | cp;
+    if (auto it = atlas.glyphs.find(key); it != atlas.glyphs.end()) {
+        ++atlas.hits;
+        return &it->second;
+    }
+    ++atlas.misses;
+    ++ctx.stats.rasterizations;
+
+    int minx, maxx, miny, maxy, advance;
+    if (::TTF_GlyphMetrics32(fc.font, cp, &minx, &maxx, &miny, &maxy, &advance) != 0) {
+        return nullptr;
+    }
+    ::SDL_Surface* surf = ::TTF_RenderGlyph32_Solid(fc.font, cp, {255, 255, 255, 255});
+    if (surf == nullptr) {
+        return nullptr;
+    }
+    ::SDL_Surface* rgba = ::SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_RGBA32, 0);
+    ::SDL_FreeSurface(surf);
+    if (rgba == nullptr) {
+        return nullptr;
+    }
+
+    glyph g{{0, 0, rgba->w, rgba->h}, std::min(minx, 0), advance};
+    if (g.src.w > atlas.side || g.src.h > atlas.side) {
+        ::SDL_FreeSurface(rgba);
+        return nullptr;
+    }
+    if (atlas.shelf_x + g.src.w > atlas.side) {
+        atlas.shelf_x = 0;
+        atlas.shelf_y += atlas.shelf_h + 1;
+        atlas.shelf_h = 0;
+    }
+    if (atlas.shelf_y + g.src.h > atlas.side) {
+        // Atlas is full, flush pending quads that refer to it and start over. The text drawing them records its damage
+        // after its last glyph, so the flushed quads are recorded here.
+        if (damage_tracked(ctx) && !ctx.vertices.empty() && !damage_add(ctx, bounds(ctx.vertices))) {
+            ctx.vertices.clear();
+            ctx.indices.clear();
+        }
+        render_quads(ctx, atlas.texture);
+        atlas.evictions += atlas.glyphs.size();
+        atlas.glyphs.clear();
+        atlas.shelf_x = atlas.shelf_y = atlas.shelf_h = 0;
+    }
+    g.src.x = atlas.shelf_x;
+    g.src.y = atlas.shelf_y;
+    ::SDL_UpdateTexture(atlas.texture, &g.src, rgba->pixels, rgba->pitch);
+    upload_count(ctx, static_cast<std::size_t>(g.src.w) * static_cast<std::size_t>(g.src.h) * 4);
+    ::SDL_FreeSurface(rgba);
+    atlas.shelf_x += g.src.w + 1;
+    atlas.shelf_h = std::max(atlas.shelf_h, g.src.h);
+
+    return &atlas.glyphs.emplace(key, g).first->second;
 }
 
-void canvas_clear(void* handle, color const& col) noexcept
+}
+
+void canvas_draw_text(void* handle, std::string const& text, void* font_handle, point const& p, color const& col) noexcept
 {
-    ::SDL_SetRenderDrawColor(reinterpret_cast<::SDL_Renderer*>(handle), col.r, col.g, col.b, col.a);
-    ::SDL_RenderClear(reinterpret_cast<::SDL_Renderer*>(handle));
+    if (handle == nullptr) {
+        return;
+    }
+    auto& ctx = context(handle);
+    auto& fc = font_ctx(font_handle);
+    if (!atlas_acquire(fc, ctx)) {
+        return;
+    }
+
+    auto const scale = 1.f / static_cast<float>(fc.atlas.side);
+    auto x = p.x;
+    uint32_t prev{};
+    for (std::size_t i = 0; i < text.size();) {
+        auto const cp = utf8_next(text, i);
+        if (prev != 0) {
+            x += kerning_find(fc, prev, cp);
+        }
+        prev = cp;
+        if (auto const* g = glyph_find(fc, ctx, cp, glyph_mode::solid)) {
+            push_quad(ctx, {x + g->offset, p.y, g->src.w, g->src.h}, g->src, scale, col);
+            x += g->advance;
+        }
+    }
+    if (damage_tracked(ctx) && !damage_add(ctx, bounds(ctx.vertices))) {
+        ctx.vertices.clear();
+        ctx.indices.clear();
+    } else {
+        draw_count(ctx, ctx.stats.draw_calls.texts, 0);
+    }
+    render_quads(ctx, fc.atlas.texture);
 }
 
-void color_set(void* handle, color const& col) noexcept
+void canvas_render(void* handle) noexcept
 {
-    ::SDL_SetRenderDrawColor(reinterpret_cast<::SDL_Renderer*>(handle), col.r, col.g, col.b, col.a);
+    if (handle == nullptr) {
+        return;
+    }
+    using clock = std::chrono::steady_clock;
+    auto const ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    auto& ctx = context(handle);
+    auto const start = clock::now();
+    if (ctx.frame != nullptr) {
+        ::SDL_SetRenderTarget(ctx.renderer, nullptr);
+        ::SDL_RenderSetClipRect(ctx.renderer, nullptr);
+        if (ctx.backbuffer_kept) {
+            for (auto const& d : ctx.damage) {
+                ::SDL_Rect area{d.pos.x, d.pos.y, d.size.x, d.size.y};
+                ::SDL_RenderCopy(ctx.renderer, ctx.frame, &area, &area);
+            }
+            ctx.stats.sdl_calls += 2 + ctx.damage.size();
+        } else {
+            ::SDL_RenderCopy(ctx.renderer, ctx.frame, nullptr, nullptr);
+            ctx.stats.sdl_calls += 3;
+        }
+    }
+
+    // With vsync on, presenting blocks until the next vertical blank
+    auto const present = clock::now();
+    ::SDL_RenderPresent(ctx.renderer);
+    ++ctx.stats.sdl_calls;
+    auto const presented = clock::now();
+
+    if (ctx.frame != nullptr) {
+        ::SDL_SetRenderTarget(ctx.renderer, ctx.target != nullptr ? ctx.target : ctx.frame);
+        ++ctx.stats.sdl_calls;
+        ctx.last_damage.swap(ctx.damage);
+        ctx.damage.clear();
+        ctx.invalidated.reset();
+        clip_apply(ctx);
+    }
+    uploads_process(ctx);
+
+    ctx.stats.render_ms = ms(present - start) + ms(clock::now() - presented);
+    ctx.stats.present_ms = ms(presented - present);
+    if (ctx.last_render != clock::time_point{}) {
+        ctx.stats.frame_ms = ms(start - ctx.last_render);
+        ctx.frame_times[ctx.frames++ % frame_times_max] = static_cast<float>(ctx.stats.frame_ms);
+    }
+    ctx.last_render = start;
+    ctx.last_stats = std::exchange(ctx.stats, {});
 }
 
-void canvas_line(void* handle, point const& p0, point const& p1) noexcept
+void canvas_clear(void* handle, color const& col) noexcept
 {
-    ::SDL_RenderDrawLine(reinterpret_cast<::SDL_Renderer*>(handle), p0.x, p0.y, p1.x, p1.y);
+    if (handle == nullptr) {
+        return;
+    }
+    // Clearing also makes col the current drawing color
+    auto& ctx = context(handle);
+    ctx.col = col;
+    color_apply(ctx, col);
+    if (damage_tracked(ctx) && ctx.invalidated) {
+        // SDL clears the whole target regardless of clipping, so only the invalidated region is filled instead
+        ::SDL_Rect area{ctx.invalidated->pos.x, ctx.invalidated->pos.y, ctx.invalidated->size.x, ctx.invalidated->size.y};
+        ::SDL_RenderSetClipRect(ctx.renderer, nullptr);
+        ::SDL_SetRenderDrawBlendMode(ctx.renderer, SDL_BLENDMODE_NONE);
+        ::SDL_RenderFillRect(ctx.renderer, &area);
+        ::SDL_SetRenderDrawBlendMode(ctx.renderer, sdl_blend(ctx.mode));
+        ctx.stats.sdl_calls += 4;
+        clip_apply(ctx);
+        return;
+    }
+    // The whole frame is damaged, whatever the clip rectangle
+    if (damage_tracked(ctx)) {
+        rects_merge(ctx.damage, {{}, ctx.frame_size}, damage_rects_max);
+    }
+    ::SDL_RenderClear(ctx.renderer);
+    ++ctx.stats.sdl_calls;
 }
 
 }
@@ -40,15 +40,9 @@ int main()
 
     // sRGB color blending
     auto start{can.first() + can.size() / 2 - gfx::vector{256 + 128, can.size().y / 4 + 50}};
-    for (auto i = 0; i < 256; ++i) {
-        gfx::draw_line(can, start + gfx::vector{i, 0}, start + gfx::vector{i, 100}, gfx::color_blend(gfx::green, gfx::red, i / 256.f));
-    }
-    for (auto i = 0; i < 256; ++i) {
-        gfx::draw_line(can, start + gfx::vector{i + 256, 0}, start + gfx::vector{i + 256, 100}, gfx::color_blend(gfx::blue, gfx::green, i / 256.f));
-    }
-    for (auto i = 0; i < 256; ++i) {
-        gfx::draw_line(can, start + gfx::vector{i + 512, 0}, start + gfx::vector{i + 512, 100}, gfx::color_blend(gfx::red, gfx::blue, i / 256.f));
-    }
+    gfx::draw_gradient_rect(can, start, {256, 101}, gfx::red, gfx::green);
+    gfx::draw_gradient_rect(can, start + gfx::vector{256, 0}, {256, 101}, gfx::green, gfx::blue);
+    gfx::draw_gradient_rect(can, start + gfx::vector{512, 0}, {256, 101}, gfx::blue, gfx::red);
 
     // Black diagonal line from top-left to bottom-right corner
     gfx::draw_line(can, can.first(), can.last(), gfx::black);
@@ -21,6 +21,9 @@ target("gfx")
     add_packages("libsdl2")
     add_packages("libsdl_image")
     add_packages("libsdl_ttf")
+    if is_plat("linux") then
+        add_syslinks("pthread", {public = true})
+    end
 
 target("test")
     add_files("test/*.cpp")
@@ -30,3 +33,18 @@ target("test")
         os.cp("test/*.png", target:targetdir())
         os.cp("test/*.ttf", target:targetdir())
     end)
+
+target("bench_record")
+    set_default(false)
+    add_files("bench/record.cpp")
+    add_includedirs("include")
+    add_deps("gfx")
+
+target("bench")
+    set_default(false)
+    add_files("bench/primitives.cpp")
+    add_includedirs("include")
+    add_deps("gfx")
+    after_build(function (target)
+        os.cp("test/*.ttf", target:targetdir())
+    end)